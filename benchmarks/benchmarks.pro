@@ -0,0 +1,4 @@
+TEMPLATE = subdirs
+# the enumerator benchmarks work on synthetic sysfs trees
+linux*:SUBDIRS = enumbench enumbench_udev
+unix:SUBDIRS += pingpong
@@ -0,0 +1,19 @@
+TEMPLATE = app
+DEPENDPATH += $$PWD
+CONFIG += console
+CONFIG -= app_bundle
+QT = core
+
+qesp_linux_udev {
+    # must come first, so the stand-in's libudev.h is found
+    INCLUDEPATH += $$PWD
+    DEFINES += ENUMBENCH_UDEV
+    HEADERS += $$PWD/libudev.h \
+               $$PWD/fakeudev.h
+    SOURCES += $$PWD/fakeudev.cpp
+}
+
+include(../../src/qextserialport.pri)
+LIBS -= -ludev
+
+SOURCES += $$PWD/main.cpp
@@ -0,0 +1,2 @@
+# Enumeration from sysfs, the default on Linux
+include(enumbench.pri)
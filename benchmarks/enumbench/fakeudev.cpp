@@ -0,0 +1,303 @@
+/*
+    A stand-in for libudev on top of a synthetic tree.
+
+    Devices are the entries of $QESP_SYSFS_ROOT/class/tty. What udevd's rules
+    would have found out about them (vendor, model, serial, path and the
+    by-id links) is read from $QESP_DEV_ROOT/.udev/data/<name>, in the
+    "E:KEY=value" and "S:link" lines of udev's database. Device nodes and
+    links are reported below /dev, like udev does.
+
+    A monitor is one end of a local socket pair; fakeUdevSendEvent() writes
+    the events to the other end, so they reach the port cache through the
+    same poll and receive calls as the real netlink messages.
+*/
+#include "fakeudev.h"
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QVector>
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+#include "libudev.h"
+}
+
+struct udev
+{
+    int unused;
+};
+
+struct udev_list_entry
+{
+    QByteArray name;
+    QByteArray value;
+    udev_list_entry *next;
+};
+
+struct udev_device
+{
+    QByteArray syspath;
+    QByteArray devnode;
+    QByteArray action;
+    QVector<udev_list_entry> properties;
+    QVector<udev_list_entry> devlinks;
+};
+
+struct udev_monitor
+{
+    int fds[2];
+};
+
+struct udev_enumerate
+{
+    QVector<udev_list_entry> devices;
+};
+
+struct FakeUdevMonitors
+{
+    QMutex mutex;
+    QList<udev_monitor *> monitors;
+};
+
+Q_GLOBAL_STATIC(FakeUdevMonitors, fakeUdevMonitors)
+
+static QByteArray sysfsRoot()
+{
+    QByteArray root = qgetenv("QESP_SYSFS_ROOT");
+    return root.isEmpty() ? QByteArray("/sys") : root;
+}
+
+static QByteArray devRoot()
+{
+    QByteArray root = qgetenv("QESP_DEV_ROOT");
+    return root.isEmpty() ? QByteArray("/dev") : root;
+}
+
+static void appendEntry(QVector<udev_list_entry> *list, const QByteArray &name, const QByteArray &value)
+{
+    udev_list_entry entry = { name, value, 0 };
+    list->append(entry);
+}
+
+// to be called once the list is complete, appending moves the entries
+static void linkEntries(QVector<udev_list_entry> *list)
+{
+    for (int i = 0; i < list->size(); ++i)
+        (*list)[i].next = i + 1 < list->size() ? &(*list)[i + 1] : 0;
+}
+
+static bool entryLessThan(const udev_list_entry &a, const udev_list_entry &b)
+{
+    return a.name < b.name;
+}
+
+static udev_device *newDevice(const QByteArray &syspath, const QByteArray &action)
+{
+    const QByteArray name = syspath.mid(syspath.lastIndexOf('/') + 1);
+    udev_device *device = new udev_device;
+    device->syspath = syspath;
+    device->devnode = "/dev/" + name;
+    device->action = action;
+
+    QFile database(QString::fromLocal8Bit(devRoot() + "/.udev/data/" + name));
+    if (database.open(QIODevice::ReadOnly)) {
+        foreach (const QByteArray &line, database.readAll().split('\n')) {
+            if (line.startsWith("E:")) {
+                int equals = line.indexOf('=');
+                if (equals > 2)
+                    appendEntry(&device->properties, line.mid(2, equals - 2), line.mid(equals + 1));
+            } else if (line.startsWith("S:")) {
+                appendEntry(&device->devlinks, "/dev/" + line.mid(2), QByteArray());
+            }
+        }
+    }
+    linkEntries(&device->properties);
+    linkEntries(&device->devlinks);
+    return device;
+}
+
+static void sendToMonitors(const QByteArray &message)
+{
+    FakeUdevMonitors *registry = fakeUdevMonitors();
+    QMutexLocker locker(&registry->mutex);
+    foreach (udev_monitor *monitor, registry->monitors) {
+        if (::send(monitor->fds[1], message.constData(), size_t(message.size()), 0) == -1)
+            qWarning("fakeudev: cannot queue event: %s", strerror(errno));
+    }
+}
+
+void fakeUdevSendEvent(const char *action, const QByteArray &name)
+{
+    sendToMonitors(QByteArray(action) + ' ' + name);
+}
+
+void fakeUdevSendOverflow()
+{
+    sendToMonitors("overflow");
+}
+
+struct udev *udev_new(void)
+{
+    return new udev;
+}
+
+struct udev *udev_unref(struct udev *udev)
+{
+    delete udev;
+    return 0;
+}
+
+struct udev_list_entry *udev_list_entry_get_next(struct udev_list_entry *list_entry)
+{
+    return list_entry->next;
+}
+
+const char *udev_list_entry_get_name(struct udev_list_entry *list_entry)
+{
+    return list_entry->name.constData();
+}
+
+struct udev_device *udev_device_new_from_syspath(struct udev *, const char *syspath)
+{
+    return newDevice(syspath, QByteArray());
+}
+
+struct udev_device *udev_device_unref(struct udev_device *udev_device)
+{
+    delete udev_device;
+    return 0;
+}
+
+const char *udev_device_get_syspath(struct udev_device *udev_device)
+{
+    return udev_device->syspath.constData();
+}
+
+const char *udev_device_get_devnode(struct udev_device *udev_device)
+{
+    return udev_device->devnode.constData();
+}
+
+const char *udev_device_get_action(struct udev_device *udev_device)
+{
+    return udev_device->action.isEmpty() ? 0 : udev_device->action.constData();
+}
+
+const char *udev_device_get_property_value(struct udev_device *udev_device, const char *key)
+{
+    foreach (const udev_list_entry &entry, udev_device->properties) {
+        if (entry.name == key)
+            return entry.value.constData();
+    }
+    return 0;
+}
+
+struct udev_list_entry *udev_device_get_devlinks_list_entry(struct udev_device *udev_device)
+{
+    return udev_device->devlinks.isEmpty() ? 0 : udev_device->devlinks.data();
+}
+
+struct udev_monitor *udev_monitor_new_from_netlink(struct udev *, const char *)
+{
+    udev_monitor *monitor = new udev_monitor;
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, monitor->fds) == -1) {
+        delete monitor;
+        return 0;
+    }
+    // like the netlink socket of a real monitor
+    ::fcntl(monitor->fds[0], F_SETFL, ::fcntl(monitor->fds[0], F_GETFL) | O_NONBLOCK);
+
+    FakeUdevMonitors *registry = fakeUdevMonitors();
+    QMutexLocker locker(&registry->mutex);
+    registry->monitors.append(monitor);
+    return monitor;
+}
+
+struct udev_monitor *udev_monitor_unref(struct udev_monitor *udev_monitor)
+{
+    {
+        FakeUdevMonitors *registry = fakeUdevMonitors();
+        QMutexLocker locker(&registry->mutex);
+        registry->monitors.removeOne(udev_monitor);
+    }
+    ::close(udev_monitor->fds[0]);
+    ::close(udev_monitor->fds[1]);
+    delete udev_monitor;
+    return 0;
+}
+
+int udev_monitor_filter_add_match_subsystem_devtype(struct udev_monitor *, const char *, const char *)
+{
+    return 0;
+}
+
+int udev_monitor_enable_receiving(struct udev_monitor *)
+{
+    return 0;
+}
+
+int udev_monitor_get_fd(struct udev_monitor *udev_monitor)
+{
+    return udev_monitor->fds[0];
+}
+
+struct udev_device *udev_monitor_receive_device(struct udev_monitor *udev_monitor)
+{
+    char buffer[512];
+    ssize_t size = ::recv(udev_monitor->fds[0], buffer, sizeof(buffer), 0);
+    if (size <= 0)
+        return 0;
+    const QByteArray message(buffer, int(size));
+    if (message == "overflow") {
+        errno = ENOBUFS;
+        return 0;
+    }
+    int space = message.indexOf(' ');
+    return newDevice(sysfsRoot() + "/class/tty/" + message.mid(space + 1), message.left(space));
+}
+
+struct udev_enumerate *udev_enumerate_new(struct udev *)
+{
+    return new udev_enumerate;
+}
+
+struct udev_enumerate *udev_enumerate_unref(struct udev_enumerate *udev_enumerate)
+{
+    delete udev_enumerate;
+    return 0;
+}
+
+int udev_enumerate_add_match_subsystem(struct udev_enumerate *, const char *)
+{
+    // the synthetic tree only has ttys
+    return 0;
+}
+
+int udev_enumerate_scan_devices(struct udev_enumerate *udev_enumerate)
+{
+    const QByteArray classPath = sysfsRoot() + "/class/tty";
+    DIR *dir = ::opendir(classPath.constData());
+    if (!dir)
+        return -errno;
+    udev_enumerate->devices.clear();
+    while (struct dirent *entry = ::readdir(dir)) {
+        if (entry->d_name[0] != '.')
+            appendEntry(&udev_enumerate->devices, classPath + '/' + entry->d_name, QByteArray());
+    }
+    ::closedir(dir);
+    std::sort(udev_enumerate->devices.begin(), udev_enumerate->devices.end(), entryLessThan);
+    linkEntries(&udev_enumerate->devices);
+    return 0;
+}
+
+struct udev_list_entry *udev_enumerate_get_list_entry(struct udev_enumerate *udev_enumerate)
+{
+    return udev_enumerate->devices.isEmpty() ? 0 : udev_enumerate->devices.data();
+}
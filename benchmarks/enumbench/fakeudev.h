@@ -0,0 +1,18 @@
+#ifndef ENUMBENCH_FAKEUDEV_H
+#define ENUMBENCH_FAKEUDEV_H
+
+#include <QtCore/QByteArray>
+
+/*
+    Queues a uevent with \a action ("add" or "remove") for the tty \a name on
+    every monitor, as the kernel and udevd would after a hotplug.
+*/
+void fakeUdevSendEvent(const char *action, const QByteArray &name);
+
+/*
+    Makes the next receive on every monitor fail as after a socket overflow,
+    which has the port cache enumerate again.
+*/
+void fakeUdevSendOverflow();
+
+#endif // ENUMBENCH_FAKEUDEV_H
@@ -0,0 +1,44 @@
+/*
+    The part of the libudev API that QextSerialEnumerator uses, implemented
+    by fakeudev.cpp so the udev build can run against a synthetic tree.
+*/
+#ifndef ENUMBENCH_LIBUDEV_H
+#define ENUMBENCH_LIBUDEV_H
+
+struct udev;
+struct udev_list_entry;
+struct udev_device;
+struct udev_monitor;
+struct udev_enumerate;
+
+struct udev *udev_new(void);
+struct udev *udev_unref(struct udev *udev);
+
+struct udev_list_entry *udev_list_entry_get_next(struct udev_list_entry *list_entry);
+const char *udev_list_entry_get_name(struct udev_list_entry *list_entry);
+#define udev_list_entry_foreach(list_entry, first_entry) \
+    for (list_entry = first_entry; list_entry; list_entry = udev_list_entry_get_next(list_entry))
+
+struct udev_device *udev_device_new_from_syspath(struct udev *udev, const char *syspath);
+struct udev_device *udev_device_unref(struct udev_device *udev_device);
+const char *udev_device_get_syspath(struct udev_device *udev_device);
+const char *udev_device_get_devnode(struct udev_device *udev_device);
+const char *udev_device_get_action(struct udev_device *udev_device);
+const char *udev_device_get_property_value(struct udev_device *udev_device, const char *key);
+struct udev_list_entry *udev_device_get_devlinks_list_entry(struct udev_device *udev_device);
+
+struct udev_monitor *udev_monitor_new_from_netlink(struct udev *udev, const char *name);
+struct udev_monitor *udev_monitor_unref(struct udev_monitor *udev_monitor);
+int udev_monitor_filter_add_match_subsystem_devtype(struct udev_monitor *udev_monitor,
+                                                    const char *subsystem, const char *devtype);
+int udev_monitor_enable_receiving(struct udev_monitor *udev_monitor);
+int udev_monitor_get_fd(struct udev_monitor *udev_monitor);
+struct udev_device *udev_monitor_receive_device(struct udev_monitor *udev_monitor);
+
+struct udev_enumerate *udev_enumerate_new(struct udev *udev);
+struct udev_enumerate *udev_enumerate_unref(struct udev_enumerate *udev_enumerate);
+int udev_enumerate_add_match_subsystem(struct udev_enumerate *udev_enumerate, const char *subsystem);
+int udev_enumerate_scan_devices(struct udev_enumerate *udev_enumerate);
+struct udev_list_entry *udev_enumerate_get_list_entry(struct udev_enumerate *udev_enumerate);
+
+#endif // ENUMBENCH_LIBUDEV_H
@@ -0,0 +1,487 @@
+/*
+    Measures QextSerialEnumerator against generated device trees.
+
+    For every requested number of ports a synthetic /sys and /dev is built in
+    a temporary directory and handed to the enumerator through
+    QESP_SYSFS_ROOT and QESP_DEV_ROOT. Besides the USB serial adapters the
+    tree holds the entries a real system has and the enumerator must skip:
+    64 virtual terminals and four unused 8250 ports.
+
+    getPorts() is timed (median and 99th percentile), its heap allocations
+    are counted by wrapping glibc's allocator and its system calls by tracing
+    a forked child with ptrace.
+
+    enumbench reads the tree through sysfs, as the library does on Linux by
+    default. enumbench_udev is built with qesp_linux_udev against the libudev
+    stand-in in fakeudev.cpp: there getPorts() is served by the port cache,
+    "rescan" forces the cache to enumerate again, and hotplug events are
+    injected into the cache's monitor to time them until deviceDiscovered()
+    and deviceRemoved() are emitted.
+
+    Usage: enumbench [--ports 16,256,1024] [--iterations 200] [--events 100]
+*/
+#include "qextserialenumerator.h"
+#ifdef ENUMBENCH_UDEV
+#  include "fakeudev.h"
+#endif
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <algorithm>
+#include <functional>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+/*
+    Qt's containers and operator new all end up in malloc(). The definitions
+    here take precedence over glibc's for the whole process and forward to
+    its allocator.
+*/
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static QBasicAtomicInteger<quint64> allocationCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+extern "C" void *malloc(size_t size) __THROW
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) __THROW
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) __THROW
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_realloc(ptr, size);
+}
+#  define ENUMBENCH_COUNT_ALLOCATIONS
+#endif
+
+/*
+    A sysfs and device tree with USB serial adapters, laid out like the
+    kernel and udev do it.
+*/
+class SyntheticTree
+{
+public:
+    explicit SyntheticTree(const QString &root);
+
+    void addPort(int index);
+    void removePort(int index);
+
+    static QByteArray portName(int index) { return "ttyUSB" + QByteArray::number(index); }
+
+private:
+    QString usbDevicePath(int index) const;
+    static QByteArray serialNumber(int index);
+    static QString byIdName(int index);
+    static void writeFile(const QString &fileName, const QByteArray &data);
+    static void link(const QString &target, const QString &linkName);
+
+    QString sys;
+    QString dev;
+};
+
+SyntheticTree::SyntheticTree(const QString &root)
+    : sys(root + QLatin1String("/sys")), dev(root + QLatin1String("/dev"))
+{
+    QDir dir;
+    dir.mkpath(sys + QLatin1String("/class/tty"));
+    dir.mkpath(sys + QLatin1String("/bus/usb-serial/drivers/ftdi_sio"));
+    dir.mkpath(sys + QLatin1String("/bus/platform/drivers/serial8250"));
+    dir.mkpath(dev + QLatin1String("/serial/by-id"));
+    dir.mkpath(dev + QLatin1String("/.udev/data"));
+
+    // virtual terminals have no device behind them
+    for (int i = 0; i < 64; ++i) {
+        const QString name = QString::fromLatin1("tty%1").arg(i);
+        const QString tty = sys + QLatin1String("/devices/virtual/tty/") + name;
+        dir.mkpath(tty);
+        link(tty, sys + QLatin1String("/class/tty/") + name);
+    }
+
+    // serial core ports without hardware report type 0
+    const QString platform = sys + QLatin1String("/devices/platform/serial8250");
+    dir.mkpath(platform);
+    link(sys + QLatin1String("/bus/platform/drivers/serial8250"), platform + QLatin1String("/driver"));
+    for (int i = 0; i < 4; ++i) {
+        const QString name = QString::fromLatin1("ttyS%1").arg(i);
+        const QString tty = platform + QLatin1String("/tty/") + name;
+        dir.mkpath(tty);
+        writeFile(tty + QLatin1String("/type"), "0\n");
+        link(platform, tty + QLatin1String("/device"));
+        link(tty, sys + QLatin1String("/class/tty/") + name);
+    }
+
+    qputenv("QESP_SYSFS_ROOT", QFile::encodeName(sys));
+    qputenv("QESP_DEV_ROOT", QFile::encodeName(dev));
+}
+
+QString SyntheticTree::usbDevicePath(int index) const
+{
+    return sys + QString::fromLatin1("/devices/pci0000:00/0000:00:14.0/usb1/1-%1").arg(index + 1);
+}
+
+QByteArray SyntheticTree::serialNumber(int index)
+{
+    return "BENCH" + QByteArray::number(index).rightJustified(5, '0');
+}
+
+QString SyntheticTree::byIdName(int index)
+{
+    return QLatin1String("usb-FTDI_Bench_") + QString::fromLatin1(serialNumber(index))
+            + QLatin1String("-if00-port0");
+}
+
+void SyntheticTree::addPort(int index)
+{
+    const QString name = QString::fromLatin1(portName(index));
+    const QString usb = usbDevicePath(index);
+    const QString interface = usb + QString::fromLatin1("/1-%1:1.0/").arg(index + 1) + name;
+    const QString tty = interface + QLatin1String("/tty/") + name;
+    QDir().mkpath(tty);
+
+    writeFile(usb + QLatin1String("/idVendor"), "0403\n");
+    writeFile(usb + QLatin1String("/idProduct"), "6001\n");
+    writeFile(usb + QLatin1String("/serial"), serialNumber(index) + '\n');
+    link(sys + QLatin1String("/bus/usb-serial/drivers/ftdi_sio"), interface + QLatin1String("/driver"));
+    link(interface, tty + QLatin1String("/device"));
+    link(tty, sys + QLatin1String("/class/tty/") + name);
+
+    writeFile(dev + QLatin1Char('/') + name, QByteArray());
+    link(QLatin1String("../../") + name, dev + QLatin1String("/serial/by-id/") + byIdName(index));
+    writeFile(dev + QLatin1String("/.udev/data/") + name,
+              "E:ID_VENDOR_ID=0403\n"
+              "E:ID_MODEL_ID=6001\n"
+              "E:ID_SERIAL=FTDI_Bench_" + serialNumber(index) + "\n"
+              "E:ID_PATH=pci-0000:00:14.0-usb-0:" + QByteArray::number(index + 1) + ":1.0\n"
+              "S:serial/by-id/" + QFile::encodeName(byIdName(index)) + "\n");
+}
+
+void SyntheticTree::removePort(int index)
+{
+    const QString name = QString::fromLatin1(portName(index));
+    QFile::remove(sys + QLatin1String("/class/tty/") + name);
+    QDir(usbDevicePath(index)).removeRecursively();
+    QFile::remove(dev + QLatin1Char('/') + name);
+    QFile::remove(dev + QLatin1String("/serial/by-id/") + byIdName(index));
+    QFile::remove(dev + QLatin1String("/.udev/data/") + name);
+}
+
+void SyntheticTree::writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+        qFatal("enumbench: cannot write %s", qPrintable(fileName));
+}
+
+void SyntheticTree::link(const QString &target, const QString &linkName)
+{
+    if (::symlink(QFile::encodeName(target).constData(), QFile::encodeName(linkName).constData()) != 0)
+        qFatal("enumbench: cannot create link %s", qPrintable(linkName));
+}
+
+struct Result
+{
+    qint64 median;
+    qint64 p99;
+    double allocations;     // per call, -1 if not counted
+    double syscalls;        // per call, -1 if not traced
+};
+
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    return sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * percent / 100);
+}
+
+/*
+    Runs \a iterations rounds of \a prepare, followed by \a call if
+    \a measured is true, in a child traced with ptrace and returns the number
+    of system calls the child made. Returns -1 if it cannot be traced.
+*/
+static qint64 tracedSyscalls(const std::function<void()> &prepare, const std::function<void()> &call,
+                             int iterations, bool measured)
+{
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = ::fork();
+    if (pid == -1)
+        return -1;
+    if (pid == 0) {
+        if (::ptrace(PTRACE_TRACEME, 0, (void *)0, (void *)0) == -1)
+            ::_exit(1);
+        ::raise(SIGSTOP);
+        for (int i = 0; i < iterations; ++i) {
+            prepare();
+            if (measured)
+                call();
+        }
+        ::_exit(0);
+    }
+
+    int status;
+    if (::waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, &status, 0);
+        return -1;
+    }
+    ::ptrace(PTRACE_SETOPTIONS, pid, (void *)0, (void *)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+    // every system call stops the child twice, on entry and on exit
+    qint64 stops = 0;
+    int signal = 0;
+    forever {
+        if (::ptrace(PTRACE_SYSCALL, pid, (void *)0, (void *)(long)signal) == -1 || ::waitpid(pid, &status, 0) != pid)
+            break;
+        if (WIFEXITED(status))
+            return WEXITSTATUS(status) == 0 ? (stops + 1) / 2 : -1;
+        if (WIFSIGNALED(status))
+            return -1;
+        signal = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80))
+            ++stops;
+        else
+            signal = WSTOPSIG(status);
+    }
+    ::kill(pid, SIGKILL);
+    ::waitpid(pid, &status, 0);
+    return -1;
+}
+
+/*
+    Times \a iterations calls of \a call, each after an untimed \a prepare.
+*/
+static Result measure(const std::function<void()> &prepare, const std::function<void()> &call, int iterations)
+{
+    // warm up
+    prepare();
+    call();
+
+    QVector<qint64> samples;
+    samples.reserve(iterations);
+    quint64 allocations = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        prepare();
+#ifdef ENUMBENCH_COUNT_ALLOCATIONS
+        quint64 before = allocationCount.load();
+#endif
+        timer.start();
+        call();
+        samples.append(timer.nsecsElapsed());
+#ifdef ENUMBENCH_COUNT_ALLOCATIONS
+        allocations += allocationCount.load() - before;
+#endif
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.median = percentile(samples, 50);
+    result.p99 = percentile(samples, 99);
+#ifdef ENUMBENCH_COUNT_ALLOCATIONS
+    result.allocations = double(allocations) / iterations;
+#else
+    result.allocations = -1;
+#endif
+    // tracing stops the child twice per call, a few rounds are enough
+    const int traced = qMin(iterations, 10);
+    qint64 withCall = tracedSyscalls(prepare, call, traced, true);
+    qint64 without = tracedSyscalls(prepare, call, traced, false);
+    result.syscalls = (withCall < 0 || without < 0) ? -1 : double(withCall - without) / traced;
+    return result;
+}
+
+static QByteArray perCall(double value)
+{
+    return value < 0 ? QByteArray("n/a") : QByteArray::number(value, 'f', 1);
+}
+
+static void printResult(int ports, const char *call, const Result &result)
+{
+    printf("%7d  %-24s %10.1f %10.1f %12s %14s\n", ports, call,
+           result.median / 1000.0, result.p99 / 1000.0,
+           perCall(result.allocations).constData(), perCall(result.syscalls).constData());
+}
+
+static void checkPorts(int found, int ports)
+{
+    if (found != ports)
+        qWarning("enumbench: found %d ports instead of %d", found, ports);
+}
+
+#ifdef ENUMBENCH_UDEV
+/*
+    Adds and removes \a events ports after the \a ports already in \a tree
+    and times each uevent until the matching signal has been emitted.
+*/
+static void measureHotplug(SyntheticTree *tree, int ports, int events)
+{
+    QextSerialEnumerator enumerator;
+    enumerator.setUpNotifications();
+
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    QElapsedTimer clock;
+    QString expected;
+    qint64 latency = -1;
+    QObject::connect(&enumerator, &QextSerialEnumerator::deviceDiscovered, &loop,
+                     [&](const QextPortInfo &info) {
+        if (info.portName == expected) {
+            latency = clock.nsecsElapsed();
+            loop.quit();
+        }
+    });
+    QObject::connect(&enumerator, &QextSerialEnumerator::deviceRemoved, &loop,
+                     [&](const QextPortInfo &info) {
+        if (info.portName == expected) {
+            latency = clock.nsecsElapsed();
+            loop.quit();
+        }
+    });
+
+    QVector<qint64> added;
+    QVector<qint64> removed;
+    int missed = 0;
+    for (int i = 0; i < events; ++i) {
+        const int index = ports + i;
+        const QByteArray name = SyntheticTree::portName(index);
+        expected = QLatin1String("/dev/") + QString::fromLatin1(name);
+
+        for (int remove = 0; remove < 2; ++remove) {
+            if (remove)
+                tree->removePort(index);
+            else
+                tree->addPort(index);
+            latency = -1;
+            timeout.start(1000);
+            clock.start();
+            fakeUdevSendEvent(remove ? "remove" : "add", name);
+            loop.exec();
+            timeout.stop();
+            if (latency < 0)
+                ++missed;
+            else
+                (remove ? removed : added).append(latency);
+        }
+    }
+    std::sort(added.begin(), added.end());
+    std::sort(removed.begin(), removed.end());
+
+    printf("%7d  %-24s %10.1f %10.1f %8d\n", ports, "add -> deviceDiscovered",
+           percentile(added, 50) / 1000.0, percentile(added, 99) / 1000.0, events - added.size());
+    printf("%7d  %-24s %10.1f %10.1f %8d\n", ports, "remove -> deviceRemoved",
+           percentile(removed, 50) / 1000.0, percentile(removed, 99) / 1000.0, events - removed.size());
+    if (missed)
+        qWarning("enumbench: %d events were not signalled within a second", missed);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Measures QextSerialEnumerator on synthetic device trees."));
+    parser.addHelpOption();
+    QCommandLineOption portsOption(QStringList() << QLatin1String("n") << QLatin1String("ports"),
+                                   QLatin1String("Comma separated numbers of synthetic ports."),
+                                   QLatin1String("list"), QLatin1String("16,256,1024"));
+    QCommandLineOption iterationsOption(QLatin1String("iterations"),
+                                        QLatin1String("Timed calls per measurement."),
+                                        QLatin1String("count"), QLatin1String("200"));
+    QCommandLineOption eventsOption(QLatin1String("events"),
+                                    QLatin1String("Hotplug events per size (udev build only)."),
+                                    QLatin1String("count"), QLatin1String("100"));
+    parser.addOption(portsOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(eventsOption);
+    parser.process(app);
+
+    QList<int> sizes;
+    foreach (const QString &size, parser.value(portsOption).split(QLatin1Char(','))) {
+        bool ok;
+        int ports = size.toInt(&ok);
+        if (ok && ports >= 0)
+            sizes.append(ports);
+    }
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    const int events = qMax(0, parser.value(eventsOption).toInt());
+
+#ifdef ENUMBENCH_UDEV
+    printf("udev port cache with the libudev stand-in, %d iterations\n\n", iterations);
+#else
+    printf("sysfs enumeration, %d iterations\n\n", iterations);
+#endif
+    printf("%7s  %-24s %10s %10s %12s %14s\n", "ports", "call", "median us", "p99 us",
+           "allocs/call", "syscalls/call");
+
+    int found = 0;
+    const std::function<void()> nothing = [] {};
+    const std::function<void()> getPorts = [&found] { found = QextSerialEnumerator::getPorts().size(); };
+    foreach (int ports, sizes) {
+        QTemporaryDir dir;
+        if (!dir.isValid())
+            qFatal("enumbench: cannot create a temporary directory");
+        // sysfs paths are compared after resolving links
+        SyntheticTree tree(QDir(dir.path()).canonicalPath());
+        for (int i = 0; i < ports; ++i)
+            tree.addPort(i);
+
+#ifdef ENUMBENCH_UDEV
+        // the cache may still hold the previous tree
+        fakeUdevSendOverflow();
+        printResult(ports, "getPorts() cached", measure(nothing, getPorts, iterations));
+        checkPorts(found, ports);
+        printResult(ports, "getPorts() rescan", measure(fakeUdevSendOverflow, getPorts, iterations));
+        checkPorts(found, ports);
+#else
+        printResult(ports, "getPorts()", measure(nothing, getPorts, iterations));
+        checkPorts(found, ports);
+        printResult(ports, "getPorts(NamesOnly)", measure(nothing, [&found] {
+            found = QextSerialEnumerator::getPorts(QextSerialEnumerator::NamesOnly).size();
+        }, iterations));
+        checkPorts(found, ports);
+#endif
+    }
+
+#ifdef ENUMBENCH_UDEV
+    if (events > 0) {
+        printf("\n%7s  %-24s %10s %10s %8s\n", "ports", "event", "median us", "p99 us", "missed");
+        foreach (int ports, sizes) {
+            QTemporaryDir dir;
+            if (!dir.isValid())
+                qFatal("enumbench: cannot create a temporary directory");
+            SyntheticTree tree(QDir(dir.path()).canonicalPath());
+            for (int i = 0; i < ports; ++i)
+                tree.addPort(i);
+            fakeUdevSendOverflow();
+            checkPorts(QextSerialEnumerator::getPorts().size(), ports);
+            measureHotplug(&tree, ports, events);
+        }
+    }
+#else
+    Q_UNUSED(events);
+    printf("\nhotplug latency needs udev, see enumbench_udev\n");
+#endif
+    return 0;
+}
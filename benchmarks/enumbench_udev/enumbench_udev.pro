@@ -0,0 +1,4 @@
+# Enumeration and hotplug through the udev port cache, with the libudev
+# stand-in of enumbench instead of the real library
+CONFIG += qesp_linux_udev
+include(../enumbench/enumbench.pri)
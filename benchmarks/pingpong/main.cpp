@@ -0,0 +1,232 @@
+/*
+    Measures request/response latency and CPU cost of a QextSerialPort in
+    its receive modes, over a pseudo terminal.
+
+    The port opens the slave side of a pty; a thread on the master side
+    echoes every byte back at once. The port sends a request, waits for the
+    whole echo to be announced by readyRead() and sends the next request,
+    either right away (back-to-back, where adaptive polling switches to its
+    batched poll) or after a pause (sparse, where it stays with the
+    notifier).
+
+    For each mode the round trip time (median and 99th percentile) and the
+    CPU time the port's thread spends per round trip are reported, the
+    latter also as load of one core over the run.
+
+    Usage: pingpong [--round-trips 10000] [--size 16] [--budget 50] [--gap 2]
+*/
+#include "qextserialport.h"
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+    Echoes everything the port sends back to it.
+*/
+class EchoThread : public QThread
+{
+public:
+    explicit EchoThread(int fd) : fd(fd) {}
+
+    void stop() { stopping.storeRelease(1); wait(); }
+
+protected:
+    void run();
+
+private:
+    int fd;
+    QAtomicInt stopping;
+};
+
+void EchoThread::run()
+{
+    char buffer[4096];
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (!stopping.loadAcquire()) {
+        if (::poll(&pfd, 1, 100) <= 0)
+            continue;
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        for (ssize_t written = 0; written < n; ) {
+            ssize_t w = ::write(fd, buffer + written, size_t(n - written));
+            if (w < 0 && errno != EINTR)
+                break;
+            written += qMax(w, ssize_t(0));
+        }
+    }
+}
+
+struct Mode
+{
+    const char *name;
+    bool busyPoll;
+    bool adaptive;
+};
+
+struct Result
+{
+    qint64 median;
+    qint64 p99;
+    double cpuPerRoundTrip;     // ns
+    double load;                // share of one core
+    int lost;
+};
+
+static qint64 threadCpuTime()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    return sorted.isEmpty() ? 0 : sorted.at((sorted.size() - 1) * percent / 100);
+}
+
+/*
+    Runs \a roundTrips request/response exchanges of \a size bytes on
+    \a port, pausing \a gapMsecs between them.
+*/
+static Result pingPong(QextSerialPort *port, int roundTrips, int size, int gapMsecs)
+{
+    const QByteArray request(size, 'p');
+    QVector<qint64> samples;
+    samples.reserve(roundTrips);
+
+    QEventLoop loop;
+    QTimer watchdog;
+    watchdog.setSingleShot(true);
+    QObject::connect(&watchdog, &QTimer::timeout, &loop, &QEventLoop::quit);
+    QTimer pause;
+    pause.setSingleShot(true);
+    pause.setTimerType(Qt::PreciseTimer);
+
+    QElapsedTimer roundTrip;
+    int received = 0;
+    int lost = 0;
+    const auto send = [&] {
+        received = 0;
+        watchdog.start(1000);
+        roundTrip.start();
+        port->write(request);
+    };
+    QObject::connect(&pause, &QTimer::timeout, &loop, send);
+    QObject::connect(&watchdog, &QTimer::timeout, &loop, [&] { ++lost; });
+    QObject::connect(port, &QIODevice::readyRead, &loop, [&] {
+        received += port->readAll().size();
+        if (received < size)
+            return;
+        samples.append(roundTrip.nsecsElapsed());
+        watchdog.stop();
+        if (samples.size() == roundTrips)
+            loop.quit();
+        else if (gapMsecs > 0)
+            pause.start(gapMsecs);
+        else
+            send();
+    });
+
+    QElapsedTimer wall;
+    wall.start();
+    const qint64 cpuStart = threadCpuTime();
+    send();
+    loop.exec();
+    const qint64 cpu = threadCpuTime() - cpuStart;
+    const qint64 elapsed = wall.nsecsElapsed();
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.median = percentile(samples, 50);
+    result.p99 = percentile(samples, 99);
+    result.cpuPerRoundTrip = samples.isEmpty() ? 0 : double(cpu) / samples.size();
+    result.load = elapsed > 0 ? double(cpu) / elapsed : 0;
+    result.lost = lost;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Measures QextSerialPort round trips over a pseudo terminal."));
+    parser.addHelpOption();
+    QCommandLineOption roundTripsOption(QLatin1String("round-trips"),
+                                        QLatin1String("Round trips per measurement."),
+                                        QLatin1String("count"), QLatin1String("10000"));
+    QCommandLineOption sizeOption(QLatin1String("size"), QLatin1String("Request size in bytes."),
+                                  QLatin1String("bytes"), QLatin1String("16"));
+    QCommandLineOption budgetOption(QLatin1String("budget"), QLatin1String("Busy-poll budget."),
+                                    QLatin1String("usecs"), QLatin1String("50"));
+    QCommandLineOption gapOption(QLatin1String("gap"), QLatin1String("Pause between sparse requests."),
+                                 QLatin1String("msecs"), QLatin1String("2"));
+    parser.addOption(roundTripsOption);
+    parser.addOption(sizeOption);
+    parser.addOption(budgetOption);
+    parser.addOption(gapOption);
+    parser.process(app);
+    const int roundTrips = qMax(1, parser.value(roundTripsOption).toInt());
+    const int size = qMax(1, parser.value(sizeOption).toInt());
+    const int budget = qMax(1, parser.value(budgetOption).toInt());
+    const int gap = qMax(1, parser.value(gapOption).toInt());
+
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (master == -1 || ::grantpt(master) || ::unlockpt(master) || !::ptsname(master))
+        qFatal("pingpong: cannot open a pseudo terminal");
+    struct termios attributes;
+    if (::tcgetattr(master, &attributes) == 0) {
+        ::cfmakeraw(&attributes);
+        ::tcsetattr(master, TCSANOW, &attributes);
+    }
+
+    QextSerialPort port(QString::fromLocal8Bit(::ptsname(master)), QextSerialPort::EventDriven);
+    if (!port.open(QIODevice::ReadWrite))
+        qFatal("pingpong: cannot open %s", ::ptsname(master));
+    EchoThread echo(master);
+    echo.start();
+
+    const Mode modes[] = {
+        { "notifier", false, false },
+        { "busy-poll", true, false },
+        { "adaptive", false, true },
+        { "busy-poll + adaptive", true, true }
+    };
+
+    printf("%d round trips of %d bytes, busy-poll budget %d us, sparse gap %d ms\n\n",
+           roundTrips, size, budget, gap);
+    printf("%-22s %-13s %10s %10s %12s %9s %6s\n", "mode", "traffic", "median us", "p99 us",
+           "cpu us/rt", "cpu load", "lost");
+    for (const Mode &mode : modes) {
+        port.setBusyPollBudget(mode.busyPoll ? budget : 0);
+        port.setAdaptivePolling(mode.adaptive);
+        for (int sparse = 0; sparse < 2; ++sparse) {
+            // settle the adaptive state before timing
+            pingPong(&port, qMin(roundTrips, 100), size, sparse ? gap : 0);
+            const Result result = pingPong(&port, roundTrips, size, sparse ? gap : 0);
+            printf("%-22s %-13s %10.1f %10.1f %12.1f %8.1f%% %6d\n", mode.name,
+                   sparse ? "sparse" : "back-to-back", result.median / 1000.0, result.p99 / 1000.0,
+                   result.cpuPerRoundTrip / 1000.0, result.load * 100, result.lost);
+        }
+    }
+
+    port.close();
+    echo.stop();
+    ::close(master);
+    return 0;
+}
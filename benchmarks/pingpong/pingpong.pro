@@ -0,0 +1,9 @@
+TEMPLATE = app
+DEPENDPATH += .
+CONFIG += console
+CONFIG -= app_bundle
+QT = core
+
+include(../../src/qextserialport.pri)
+
+SOURCES += main.cpp
@@ -54,12 +54,10 @@ void MessageWindow::AppendMsgWrapper(QtMsgType type, const char *msg)
         fprintf(stderr, "%s", MessageWindow::QtMsgToQString(type, msg).toLatin1().data());
 }
 
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
 void MessageWindow::AppendMsgWrapper(QtMsgType type, const QMessageLogContext & /*context*/, const QString &msg)
 {
     AppendMsgWrapper(type, msg.toLatin1().data());
 }
-#endif
 
 void MessageWindow::customEvent(QEvent *event)
 {
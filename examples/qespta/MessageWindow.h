@@ -51,9 +51,7 @@ public:
          *     @param msg message string.
          */
     static void AppendMsgWrapper(QtMsgType type, const char *msg);
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
     static void AppendMsgWrapper(QtMsgType type, const QMessageLogContext &context, const QString &msg);
-#endif
     /**
          * Post message event to the main event loop. This function encapsulates
          * message into MessageEvent object and passes it to the main event loop.
@@ -9,6 +9,12 @@
 # Uncomment following line if you want to enable udev for linux
 # linux*:CONFIG += qesp_linux_udev
 
+# Uncomment following line if you want static tracing probes (USDT) on linux
+# linux*:CONFIG += qesp_sdt
+
+# Uncomment following line if you want LZ4 compressed port captures (needs liblz4)
+# CONFIG += qesp_lz4
+
 # Note: you can create a ".qmake.cache" file, then copy these lines to it.
 # If so, you can avoid to change this project file.
 ############################### *User Config* ###############################
@@ -20,7 +26,7 @@ defineReplace(qextLibraryName) {
       QMAKE_FRAMEWORK_BUNDLE_NAME = $$LIBRARY_NAME
       export(QMAKE_FRAMEWORK_BUNDLE_NAME)
    } else {
-       greaterThan(QT_MAJOR_VERSION, 4):LIBRARY_NAME ~= s,^Qt,Qt$$QT_MAJOR_VERSION,
+       LIBRARY_NAME ~= s,^Qt,Qt$$QT_MAJOR_VERSION,
    }
    CONFIG(debug, debug|release) {
       !debug_and_release|build_pass {
@@ -71,11 +77,7 @@ unix:QT = core
 else:QT = core gui
 
 #generate proper library name
-greaterThan(QT_MAJOR_VERSION, 4) {
-    QESP_LIB_BASENAME = QtExtSerialPort
-} else {
-    QESP_LIB_BASENAME = qextserialport
-}
+QESP_LIB_BASENAME = QtExtSerialPort
 TARGET = $$qextLibraryName($$QESP_LIB_BASENAME)
 VERSION = 1.2.0
 
@@ -0,0 +1,744 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#include "qextserialcapture_p.h"
+#include "qextserialtrace_p.h"
+#include "qextserialport_global.h"
+#include <QtCore/QDateTime>
+#include <QtCore/QFileInfo>
+#include <QtCore/QList>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QtEndian>
+#include <string.h>
+#ifdef Q_OS_UNIX
+#  include <time.h>
+#endif
+#ifdef QESP_HAVE_LZ4
+#  include <lz4.h>
+#endif
+
+using namespace QextCaptureFormat;
+
+/*
+    The thread that writes all captures of the process to disk. While any
+    capture runs it wakes up every WriteInterval ms and drains what the ports
+    have queued, so the I/O paths never have to signal it; without one it
+    sleeps until add().
+*/
+class QextCaptureWriter : public QThread
+{
+public:
+    enum { WriteInterval = 10 };
+
+    QextCaptureWriter() : stopping(false) {}
+    ~QextCaptureWriter() {
+        {
+            QMutexLocker locker(&mutex);
+            stopping = true;
+            wake.wakeAll();
+        }
+        wait();
+    }
+
+    void add(QextCapture *capture) {
+        QMutexLocker locker(&mutex);
+        captures.append(capture);
+        if (!isRunning())
+            start(QThread::LowPriority);
+        else
+            wake.wakeAll();
+    }
+    void remove(QextCapture *capture) {
+        QMutexLocker locker(&mutex);
+        captures.removeOne(capture);
+    }
+
+protected:
+    // remove() waits for a drain in progress, so a capture is never
+    // drained after its port is gone
+    void run() {
+        QMutexLocker locker(&mutex);
+        while (!stopping) {
+            if (captures.isEmpty())
+                wake.wait(&mutex);
+            else
+                wake.wait(&mutex, WriteInterval);
+            foreach (QextCapture *capture, captures)
+                capture->drain();
+        }
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition wake;
+    QList<QextCapture *> captures;
+    bool stopping;
+};
+
+Q_GLOBAL_STATIC(QextCaptureWriter, captureWriter)
+
+static inline char *putVarint(char *p, quint64 value)
+{
+    while (value >= 0x80) {
+        *p++ = char(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = char(value);
+    return p;
+}
+
+template <typename T>
+static inline void appendLE(QByteArray *out, T value)
+{
+    uchar bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    out->append(reinterpret_cast<const char *>(bytes), int(sizeof(T)));
+}
+
+static qint64 wallClockNsecs()
+{
+#ifdef Q_OS_UNIX
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    return QDateTime::currentMSecsSinceEpoch() * 1000000;
+#endif
+}
+
+QextCaptureStream::QextCaptureStream()
+{
+    for (int i = 0; i < Buffers; ++i)
+        buffers[i].data = new char[BufferSize];
+    reset();
+}
+
+QextCaptureStream::~QextCaptureStream()
+{
+    for (int i = 0; i < Buffers; ++i)
+        delete [] buffers[i].data;
+}
+
+/*
+    Puts every buffer back into the empty queue. Only while nobody appends
+    and the writer is done with the stream.
+*/
+void QextCaptureStream::reset()
+{
+    while (full.pop()) {}
+    while (empty.pop()) {}
+    for (int i = 0; i < Buffers; ++i)
+        empty.push(&buffers[i]);
+    open.store(0);
+    openSince.store(0);
+}
+
+/*
+    Queues the open buffer if it holds anything. Called by the producer, or
+    by stop() once no producer is left.
+*/
+void QextCaptureStream::seal()
+{
+    QextCaptureBuffer *buffer = open.fetchAndStoreAcquire(0);
+    if (buffer)
+        full.push(buffer);
+    openSince.store(0);
+}
+
+/*
+    Takes the open buffer away from the producer if it has been waiting for
+    more data too long. The age may be stale by the time the buffer is taken,
+    in which case a younger buffer is written early; that only costs a
+    smaller block. The caller must write the queued buffers that start
+    no later than the returned one before it, to keep the blocks in order.
+*/
+QextCaptureBuffer *QextCaptureStream::takeAged(qint64 now)
+{
+    qint64 since = openSince.load();
+    if (!since || now - since <= MaxBufferAge)
+        return 0;
+    return open.fetchAndStoreAcquire(0);
+}
+
+/*
+    Appends one record, or as much of it as fits into a buffer; returns false
+    if no buffer was free.
+*/
+bool QextCaptureStream::append(int direction, const char *data, int size, qint64 timestamp)
+{
+    // null if the writer took it, see takeAged()
+    QextCaptureBuffer *current = open.fetchAndStoreAcquire(0);
+    if (current && (current->used + MaxRecordHeader + size > BufferSize
+                    || timestamp - current->first > MaxBufferAge)) {
+        full.push(current);
+        current = 0;
+    }
+    if (!current) {
+        current = empty.pop();
+        if (!current) {
+            openSince.store(0);
+            return false;
+        }
+        current->used = 0;
+        current->records = 0;
+        current->first = timestamp;
+        current->last = timestamp;
+        openSince.store(timestamp);
+    }
+    char *p = current->data + current->used;
+    p = putVarint(p, quint64(qMax(timestamp - current->last, qint64(0))));
+    p = putVarint(p, (quint64(size) << 1) | quint64(direction));
+    memcpy(p, data, size_t(size));
+    current->used = int(p - current->data) + size;
+    current->records++;
+    current->last = timestamp;
+    open.storeRelease(current);
+    return true;
+}
+
+QextCapture::QextCapture()
+    : active(0), writers(0), sequence(0), pcapng(0), wallBase(0), writeFailed(false)
+{
+}
+
+QextCapture::~QextCapture()
+{
+    stop();
+}
+
+bool QextCapture::start(const QextCaptureOptions &captureOptions)
+{
+    QMutexLocker locker(&fileMutex);
+    options = captureOptions;
+    portName = options.portName.toUtf8();
+#ifdef QESP_HAVE_LZ4
+    if (options.compress && options.format == QextCaptureOptions::Native)
+        scratch.resize(LZ4_compressBound(QextCaptureStream::BufferSize));
+#else
+    if (options.compress)
+        QESP_WARNING("QextSerialPort: built without LZ4, capturing uncompressed");
+    options.compress = false;
+#endif
+    sequence = 0;
+    writeFailed = false;
+    bytesCaptured.store(0);
+    recordsCaptured.store(0);
+    bytesDropped.store(0);
+    recordsDropped.store(0);
+    bytesWritten.store(0);
+    filesWritten.store(0);
+    streams[Rx].reset();
+    streams[Tx].reset();
+    if (options.format == QextCaptureOptions::Pcapng) {
+        pcapng = QextPcapngFile::acquire(options.fileName);
+        if (!pcapng)
+            return false;
+        interfaceIds[Rx] = pcapng->addInterface(options.linkType, portName + " rx");
+        interfaceIds[Tx] = pcapng->addInterface(options.linkType, portName + " tx");
+        wallBase = wallClockNsecs() - QextTraceRecorder::now();
+        for (int d = 0; d < 2; ++d) {
+            frames[d].data.reserve(QextPcapngFile::SnapLength);
+            frames[d].data.resize(0);
+        }
+    } else if (!openFile()) {
+        return false;
+    }
+    locker.unlock();
+    captureWriter()->add(this);
+    active.storeRelease(1);
+    return true;
+}
+
+/*
+    Stops appending, waits for producers still inside append(), and writes
+    out what is left.
+*/
+void QextCapture::stop()
+{
+    if (!active.testAndSetOrdered(1, 0))
+        return;
+    while (writers.loadAcquire())
+        QThread::yieldCurrentThread();
+    if (!captureWriter.isDestroyed())
+        captureWriter()->remove(this);
+    streams[Rx].seal();
+    streams[Tx].seal();
+    drain();
+    QMutexLocker locker(&fileMutex);
+    if (pcapng) {
+        writeFrame(Rx);
+        writeFrame(Tx);
+        pcapng->release();
+        pcapng = 0;
+    }
+    closeFile();
+}
+
+void QextCapture::append(Direction direction, const char *data, qint64 size)
+{
+    writers.ref();
+    if (active.loadAcquire()) {
+        qint64 timestamp = QextTraceRecorder::now();
+        const int maxChunk = QextCaptureStream::BufferSize - QextCaptureStream::MaxRecordHeader;
+        while (size > 0) {
+            int chunk = int(qMin(size, qint64(maxChunk)));
+            if (!streams[direction].append(direction, data, chunk, timestamp)) {
+                // the disk fell behind
+                recordsDropped.fetchAndAddRelaxed(1);
+                bytesDropped.fetchAndAddRelaxed(quint64(size));
+                break;
+            }
+            recordsCaptured.fetchAndAddRelaxed(1);
+            bytesCaptured.fetchAndAddRelaxed(quint64(chunk));
+            data += chunk;
+            size -= chunk;
+        }
+    }
+    writers.deref();
+}
+
+/*
+    Writes the queued buffers; runs on the writer thread, and once more in
+    stop().
+*/
+void QextCapture::drain()
+{
+    QMutexLocker locker(&fileMutex);
+    if (!file.isOpen() && !pcapng)
+        return;
+    qint64 now = QextTraceRecorder::now();
+    for (int s = 0; s < 2; ++s) {
+        // the producer may queue newer buffers after the aged one was taken,
+        // so it goes in by its first timestamp rather than by queue position
+        QextCaptureBuffer *aged = streams[s].takeAged(now);
+        while (QextCaptureBuffer *buffer = streams[s].full.peek()) {
+            if (aged && buffer->first > aged->first) {
+                writeBuffer(s, aged);
+                aged = 0;
+            }
+            writeBuffer(s, streams[s].full.pop());
+        }
+        if (aged)
+            writeBuffer(s, aged);
+    }
+}
+
+void QextCapture::writeBuffer(int direction, QextCaptureBuffer *buffer)
+{
+    if (pcapng)
+        writePackets(buffer);
+    else
+        writeBlock(buffer);
+    streams[direction].empty.push(buffer);
+}
+
+bool QextCapture::openFile()
+{
+    QString fileName = options.fileName;
+    if (sequence) {
+        // capture.qcap, capture.1.qcap, capture.2.qcap, ...
+        QFileInfo info(options.fileName);
+        QString suffix = info.suffix();
+        fileName = info.path() + QLatin1Char('/') + info.completeBaseName() + QLatin1Char('.')
+                + QString::number(sequence) + (suffix.isEmpty() ? QString() : QLatin1Char('.') + suffix);
+    }
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QESP_WARNING("QextSerialPort: cannot write capture %s", qPrintable(fileName));
+        return false;
+    }
+    QByteArray header(FileMagic, 8);
+    appendLE<quint32>(&header, Version);
+    appendLE<quint32>(&header, options.compress ? CompressedFlag : 0);
+    appendLE<qint64>(&header, wallClockNsecs());
+    appendLE<qint64>(&header, QextTraceRecorder::now());
+    appendLE<quint32>(&header, sequence);
+    appendLE<quint16>(&header, quint16(portName.size()));
+    header += portName;
+    file.write(header);
+    bytesWritten.fetchAndAddRelaxed(quint64(header.size()));
+    filesWritten.fetchAndAddRelaxed(1);
+    index.clear();
+    ++sequence;
+    return true;
+}
+
+void QextCapture::closeFile()
+{
+    if (!file.isOpen())
+        return;
+    QByteArray trailer;
+    qint64 indexOffset = file.pos();
+    foreach (const IndexEntry &entry, index) {
+        appendLE<quint64>(&trailer, quint64(entry.offset));
+        appendLE<qint64>(&trailer, entry.first);
+        appendLE<qint64>(&trailer, entry.last);
+        appendLE<quint32>(&trailer, entry.records);
+        appendLE<quint32>(&trailer, 0);
+    }
+    appendLE<quint32>(&trailer, IndexMagic);
+    appendLE<quint32>(&trailer, quint32(index.size()));
+    appendLE<quint64>(&trailer, quint64(indexOffset));
+    file.write(trailer);
+    bytesWritten.fetchAndAddRelaxed(quint64(trailer.size()));
+    file.close();
+}
+
+void QextCapture::writeBlock(const QextCaptureBuffer *buffer)
+{
+    const char *payload = buffer->data;
+    int stored = buffer->used;
+#ifdef QESP_HAVE_LZ4
+    if (options.compress) {
+        int packed = LZ4_compress_default(buffer->data, scratch.data(), buffer->used, scratch.size());
+        // keep blocks that do not shrink raw
+        if (packed > 0 && packed < buffer->used) {
+            payload = scratch.constData();
+            stored = packed;
+        }
+    }
+#endif
+    IndexEntry entry;
+    entry.offset = file.pos();
+    entry.first = buffer->first;
+    entry.last = buffer->last;
+    entry.records = buffer->records;
+
+    QByteArray header;
+    appendLE<quint32>(&header, BlockMagic);
+    appendLE<quint32>(&header, quint32(stored));
+    appendLE<quint32>(&header, quint32(buffer->used));
+    appendLE<quint32>(&header, buffer->records);
+    appendLE<qint64>(&header, buffer->first);
+    appendLE<qint64>(&header, buffer->last);
+    if (file.write(header) != header.size() || file.write(payload, stored) != stored) {
+        if (!writeFailed)
+            QESP_WARNING("QextSerialPort: cannot write capture %s", qPrintable(file.fileName()));
+        writeFailed = true;
+        recordsDropped.fetchAndAddRelaxed(buffer->records);
+        return;
+    }
+    index.append(entry);
+    bytesWritten.fetchAndAddRelaxed(quint64(header.size() + stored));
+
+    if (options.maxFileSize > 0 && file.pos() >= options.maxFileSize) {
+        closeFile();
+        openFile();
+    }
+}
+
+/*
+    Cuts the records of \a buffer into packets for the pcapng file.
+*/
+void QextCapture::writePackets(const QextCaptureBuffer *buffer)
+{
+    const char *p = buffer->data;
+    const char *end = p + buffer->used;
+    qint64 timestamp = buffer->first;
+    while (p < end) {
+        quint64 delta, header;
+        if (!readVarint(&p, end, &delta) || !readVarint(&p, end, &header)
+                || quint64(end - p) < (header >> 1))
+            break;
+        int size = int(header >> 1);
+        timestamp += qint64(delta);
+        frameData(int(header & 1), timestamp, p, size);
+        p += size;
+    }
+}
+
+/*
+    A packet is recordSize bytes if the port has framing, otherwise whatever
+    arrives without a pause longer than frameGap. Since the next data is
+    needed to see the pause, a packet is written when the next one starts or
+    the capture stops.
+*/
+void QextCapture::frameData(int direction, qint64 timestamp, const char *data, int size)
+{
+    Frame &frame = frames[direction];
+    if (!frame.data.isEmpty() && options.recordSize <= 0 && timestamp - frame.last > options.frameGap)
+        writeFrame(direction);
+    int limit = options.recordSize > 0 ? qMin(options.recordSize, int(QextPcapngFile::SnapLength))
+                                       : int(QextPcapngFile::SnapLength);
+    while (size > 0) {
+        if (frame.data.isEmpty())
+            frame.first = timestamp;
+        int chunk = qMin(size, limit - frame.data.size());
+        frame.data.append(data, chunk);
+        frame.last = timestamp;
+        data += chunk;
+        size -= chunk;
+        if (frame.data.size() == limit)
+            writeFrame(direction);
+    }
+}
+
+void QextCapture::writeFrame(int direction)
+{
+    Frame &frame = frames[direction];
+    if (frame.data.isEmpty())
+        return;
+    if (pcapng->writePacket(interfaceIds[direction], direction == Rx, wallBase + frame.first,
+                            frame.data.constData(), frame.data.size())) {
+        // enhanced packet block: 32 bytes, the padded data, 12 of options
+        bytesWritten.fetchAndAddRelaxed(quint64(44 + ((frame.data.size() + 3) & ~3)));
+    } else {
+        recordsDropped.fetchAndAddRelaxed(1);
+    }
+    frame.data.resize(0);   // keeps the reserved capacity
+}
+
+QextCaptureReader::QextCaptureReader()
+    : wallStart(0), monotonicStart(0), blocksSkipped(0), window(0), windowOffset(0), windowSize(0),
+      pos(0), end(0), compressed(false)
+{
+}
+
+QextCaptureReader::~QextCaptureReader()
+{
+    close();
+}
+
+bool QextCaptureReader::open(const QString &fileName)
+{
+    close();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QESP_WARNING("QextSerialPort: cannot read capture %s", qPrintable(fileName));
+        return false;
+    }
+    end = file.size();
+    const uchar *header = map(0, 38);
+    if (!header || memcmp(header, FileMagic, 8) || qFromLittleEndian<quint32>(header + 8) != Version) {
+        QESP_WARNING("QextSerialPort: %s is not a capture file", qPrintable(fileName));
+        close();
+        return false;
+    }
+    compressed = qFromLittleEndian<quint32>(header + 12) & CompressedFlag;
+    wallStart = qFromLittleEndian<qint64>(header + 16);
+    monotonicStart = qFromLittleEndian<qint64>(header + 24);
+    int nameSize = qFromLittleEndian<quint16>(header + 36);
+    const uchar *name = map(38, nameSize);
+    if (!name) {
+        close();
+        return false;
+    }
+    portName = QByteArray(reinterpret_cast<const char *>(name), nameSize);
+    pos = 38 + nameSize;
+    if (const uchar *footer = end - pos >= FooterSize ? map(end - FooterSize, FooterSize) : 0) {
+        qint64 indexOffset = qint64(qFromLittleEndian<quint64>(footer + 8));
+        if (qFromLittleEndian<quint32>(footer) == IndexMagic && indexOffset >= pos && indexOffset <= end)
+            end = indexOffset;
+    }
+    if (compressed)
+        scratch.resize(QextCaptureStream::BufferSize);
+    return true;
+}
+
+void QextCaptureReader::close()
+{
+    if (window)
+        file.unmap(window);
+    window = 0;
+    windowSize = 0;
+    file.close();
+    portName.clear();
+    blocksSkipped = 0;
+}
+
+/*
+    Returns \a size bytes at \a offset, moving the window if they are not in
+    it, or 0 past the end of the file.
+*/
+const uchar *QextCaptureReader::map(qint64 offset, qint64 size)
+{
+    if (offset < 0 || size < 0 || offset + size > file.size())
+        return 0;
+    if (!window || offset < windowOffset || offset + size > windowOffset + windowSize) {
+        if (window)
+            file.unmap(window);
+        windowOffset = offset;
+        windowSize = qMin(qMax(qint64(WindowSize), size), file.size() - offset);
+        window = file.map(windowOffset, windowSize);
+        if (!window) {
+            windowSize = 0;
+            return 0;
+        }
+    }
+    return window + (offset - windowOffset);
+}
+
+bool QextCaptureReader::nextBlock(const char **payload, int *size, qint64 *first)
+{
+    while (pos + BlockHeaderSize <= end) {
+        const uchar *header = map(pos, BlockHeaderSize);
+        if (!header || qFromLittleEndian<quint32>(header) != BlockMagic)
+            return false;
+        quint32 stored = qFromLittleEndian<quint32>(header + 4);
+        quint32 raw = qFromLittleEndian<quint32>(header + 8);
+        *first = qFromLittleEndian<qint64>(header + 16);
+        const uchar *data = map(pos + BlockHeaderSize, stored);
+        if (!data || raw > quint32(QextCaptureStream::BufferSize) || stored > raw)
+            return false;
+        pos += BlockHeaderSize + stored;
+        if (stored == raw) {
+            *payload = reinterpret_cast<const char *>(data);
+            *size = int(raw);
+            return true;
+        }
+#ifdef QESP_HAVE_LZ4
+        if (compressed && LZ4_decompress_safe(reinterpret_cast<const char *>(data), scratch.data(),
+                                              int(stored), scratch.size()) == int(raw)) {
+            *payload = scratch.constData();
+            *size = int(raw);
+            return true;
+        }
+#endif
+        ++blocksSkipped;
+    }
+    return false;
+}
+
+struct QextPcapngRegistry
+{
+    QMutex mutex;
+    QList<QextPcapngFile *> files;
+};
+
+Q_GLOBAL_STATIC(QextPcapngRegistry, pcapngFiles)
+
+/*
+    Opens \a fileName, or joins it if another port captures into it already.
+*/
+QextPcapngFile *QextPcapngFile::acquire(const QString &fileName)
+{
+    QextPcapngRegistry *registry = pcapngFiles();
+    QMutexLocker locker(&registry->mutex);
+    QString key = QFileInfo(fileName).absoluteFilePath();
+    foreach (QextPcapngFile *pcapng, registry->files) {
+        if (pcapng->key == key) {
+            ++pcapng->refs;
+            return pcapng;
+        }
+    }
+    QextPcapngFile *pcapng = new QextPcapngFile;
+    pcapng->key = key;
+    pcapng->file.setFileName(fileName);
+    if (!pcapng->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QESP_WARNING("QextSerialPort: cannot write capture %s", qPrintable(fileName));
+        delete pcapng;
+        return 0;
+    }
+    // section header block: byte order magic, version 1.0, unknown length
+    QByteArray body;
+    appendLE<quint32>(&body, 0x1a2b3c4d);
+    appendLE<quint16>(&body, 1);
+    appendLE<quint16>(&body, 0);
+    appendLE<qint64>(&body, -1);
+    QByteArray application("QextSerialPort");
+    appendLE<quint16>(&body, 4);        // shb_userappl
+    appendLE<quint16>(&body, quint16(application.size()));
+    body += application;
+    body.append(QByteArray((4 - application.size() % 4) % 4, '\0'));
+    appendLE<quint32>(&body, 0);        // opt_endofopt
+    pcapng->appendBlock(0x0a0d0d0a, body);
+    pcapng->refs = 1;
+    registry->files.append(pcapng);
+    return pcapng;
+}
+
+void QextPcapngFile::release()
+{
+    QextPcapngRegistry *registry = pcapngFiles();
+    QMutexLocker locker(&registry->mutex);
+    if (--refs)
+        return;
+    registry->files.removeOne(this);
+    file.close();
+    delete this;
+}
+
+void QextPcapngFile::appendBlock(quint32 type, const QByteArray &body)
+{
+    QByteArray block;
+    block.reserve(body.size() + 12);
+    appendLE<quint32>(&block, type);
+    appendLE<quint32>(&block, quint32(body.size() + 12));
+    block += body;
+    appendLE<quint32>(&block, quint32(body.size() + 12));
+    file.write(block);
+}
+
+/*
+    Adds an interface description block named \a name with nanosecond
+    timestamps and returns its id.
+*/
+int QextPcapngFile::addInterface(int linkType, const QByteArray &name)
+{
+    QMutexLocker locker(&mutex);
+    QByteArray body;
+    appendLE<quint16>(&body, quint16(linkType));
+    appendLE<quint16>(&body, 0);
+    appendLE<quint32>(&body, SnapLength);
+    appendLE<quint16>(&body, 2);        // if_name
+    appendLE<quint16>(&body, quint16(name.size()));
+    body += name;
+    body.append(QByteArray((4 - name.size() % 4) % 4, '\0'));
+    appendLE<quint16>(&body, 9);        // if_tsresol: 10^-9
+    appendLE<quint16>(&body, 1);
+    body.append("\x09\0\0\0", 4);
+    appendLE<quint32>(&body, 0);
+    appendBlock(1, body);
+    return interfaces++;
+}
+
+bool QextPcapngFile::writePacket(int interfaceId, bool inbound, qint64 wallNsecs, const char *data, int size)
+{
+    QMutexLocker locker(&mutex);
+    QByteArray body;
+    body.reserve(size + 40);
+    appendLE<quint32>(&body, quint32(interfaceId));
+    appendLE<quint32>(&body, quint32(quint64(wallNsecs) >> 32));
+    appendLE<quint32>(&body, quint32(quint64(wallNsecs)));
+    appendLE<quint32>(&body, quint32(size));
+    appendLE<quint32>(&body, quint32(size));
+    body.append(data, size);
+    body.append(QByteArray((4 - size % 4) % 4, '\0'));
+    appendLE<quint16>(&body, 2);        // epb_flags: direction
+    appendLE<quint16>(&body, 4);
+    appendLE<quint32>(&body, inbound ? 1 : 2);
+    appendLE<quint32>(&body, 0);
+    appendBlock(6, body);
+    return file.error() == QFile::NoError;
+}
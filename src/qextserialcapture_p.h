@@ -0,0 +1,311 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#ifndef _QEXTSERIALCAPTURE_P_H_
+#define _QEXTSERIALCAPTURE_P_H_
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QESP API.  It exists for the convenience
+// of other QESP classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+// Capture files (QextSerialPort::startCapture()), all integers little endian:
+//
+//   file header   "QESPCAP1", u32 version, u32 flags (1: blocks may be LZ4
+//                 compressed), i64 wall clock and i64 monotonic clock at the
+//                 start of the file in ns, u32 sequence number of the file,
+//                 u16 length and UTF-8 bytes of the port name
+//   blocks        u32 "QBLK", u32 stored size, u32 raw size (stored < raw:
+//                 LZ4), u32 records, i64 first and last timestamp, payload
+//   index         per block: u64 file offset, i64 first and last timestamp,
+//                 u32 records, u32 0
+//   footer        u32 "QIDX", u32 blocks, u64 offset of the index
+//
+// A record in a block's payload is varint(ns since the previous record, the
+// first one counts from the block's first timestamp), varint(size << 1 |
+// direction) and the data. Timestamps are on the monotonic clock. Blocks
+// hold one direction each and are in order per direction. A file whose
+// writer died lacks the index and footer; its blocks can still be walked.
+namespace QextCaptureFormat {
+    enum {
+        Version = 1,
+        CompressedFlag = 0x1,
+        BlockMagic = 0x4b4c4251,    // "QBLK"
+        IndexMagic = 0x58444951,    // "QIDX"
+        BlockHeaderSize = 32,
+        IndexEntrySize = 32,
+        FooterSize = 16
+    };
+    static const char FileMagic[] = "QESPCAP1";
+
+    // reads a varint written by the capture, false if it runs past \a end
+    static inline bool readVarint(const char **p, const char *end, quint64 *value)
+    {
+        *value = 0;
+        for (int shift = 0; *p < end && shift < 64; shift += 7) {
+            uchar byte = uchar(*(*p)++);
+            *value |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+// Walks the blocks of a capture file through a memory mapped window, so a
+// file of any size is read with bounded memory. Stops at the index, or at
+// the first damaged block of a file whose writer died.
+class QextCaptureReader
+{
+public:
+    enum { WindowSize = 64 << 20 };
+
+    QextCaptureReader();
+    ~QextCaptureReader();
+
+    bool open(const QString &fileName);
+    void close();
+    // the next block's records, decompressed; false at the end
+    bool nextBlock(const char **payload, int *size, qint64 *first);
+
+    QByteArray portName;
+    qint64 wallStart;
+    qint64 monotonicStart;
+    quint64 blocksSkipped;
+
+private:
+    const uchar *map(qint64 offset, qint64 size);
+
+    QFile file;
+    uchar *window;
+    qint64 windowOffset;
+    qint64 windowSize;
+    qint64 pos;
+    qint64 end;
+    bool compressed;
+    QByteArray scratch;
+};
+
+// pcapng file shared by the captures of any number of ports. Each port
+// adds an interface per direction; packets are enhanced packet blocks with
+// nanosecond timestamps. Written by the capture writer thread.
+class QextPcapngFile
+{
+public:
+    enum { SnapLength = 65535, LinkTypeUser0 = 147 };
+
+    static QextPcapngFile *acquire(const QString &fileName);
+    void release();
+
+    int addInterface(int linkType, const QByteArray &name);
+    bool writePacket(int interfaceId, bool inbound, qint64 wallNsecs, const char *data, int size);
+
+private:
+    QextPcapngFile() : interfaces(0), refs(0) {}
+    void appendBlock(quint32 type, const QByteArray &body);
+
+    QMutex mutex;
+    QFile file;
+    QString key;
+    int interfaces;
+    int refs;
+    friend struct QextPcapngRegistry;
+};
+
+struct QextCaptureOptions
+{
+    enum Format { Native, Pcapng };
+
+    QextCaptureOptions() : maxFileSize(0), compress(false), format(Native),
+        linkType(QextPcapngFile::LinkTypeUser0), frameGap(0), recordSize(0) {}
+    QString fileName;
+    QString portName;
+    qint64 maxFileSize;
+    bool compress;
+    Format format;
+    int linkType;           // pcapng only
+    qint64 frameGap;        // pcapng: ns of silence that end a packet
+    int recordSize;         // pcapng: fixed packet size, 0 to use frameGap
+};
+
+struct QextCaptureBuffer
+{
+    char *data;
+    int used;
+    quint32 records;
+    qint64 first;
+    qint64 last;
+};
+
+// Single-producer, single-consumer queue of buffers.
+class QextCaptureQueue
+{
+public:
+    enum { Capacity = 8 };      // a power of two, >= the buffers of a stream
+
+    QextCaptureQueue() : head(0), tail(0) {}
+    void push(QextCaptureBuffer *buffer) {
+        quint32 h = head.load();
+        ring[h & (Capacity - 1)] = buffer;
+        head.storeRelease(h + 1);
+    }
+    QextCaptureBuffer *pop() {
+        quint32 t = tail.load();
+        if (t == head.loadAcquire())
+            return 0;
+        QextCaptureBuffer *buffer = ring[t & (Capacity - 1)];
+        tail.storeRelease(t + 1);
+        return buffer;
+    }
+    // consumer side: the next buffer pop() returns, or null
+    QextCaptureBuffer *peek() const {
+        quint32 t = tail.load();
+        return t == head.loadAcquire() ? 0 : ring[t & (Capacity - 1)];
+    }
+
+private:
+    QAtomicInteger<quint32> head;
+    QAtomicInteger<quint32> tail;
+    QextCaptureBuffer *ring[Capacity];
+};
+
+// One direction of a capture. The I/O path fills the open buffer and
+// queues it when full or older than MaxBufferAge; the writer thread hands
+// written buffers back. The producer claims the open buffer for each append
+// by swapping it out of \c open and publishes it again afterwards, so the
+// writer can take it over once it is older than MaxBufferAge and an idle
+// port's last data still reaches the disk. Neither side ever waits.
+struct QextCaptureStream
+{
+    enum {
+        Buffers = 4,
+        BufferSize = 64 * 1024,
+        MaxRecordHeader = 20,
+        MaxBufferAge = 200000000     // ns a buffer may wait for more data
+    };
+
+    QextCaptureStream();
+    ~QextCaptureStream();
+    void reset();
+    bool append(int direction, const char *data, int size, qint64 timestamp);
+    void seal();
+    // writer side: the open buffer if it is older than MaxBufferAge at \a now
+    QextCaptureBuffer *takeAged(qint64 now);
+
+    QextCaptureBuffer buffers[Buffers];
+    QAtomicPointer<QextCaptureBuffer> open;     // null while an append runs
+    QAtomicInteger<qint64> openSince;           // first timestamp of open, 0 if none
+    QextCaptureQueue full;      // to the writer
+    QextCaptureQueue empty;     // back from the writer
+};
+
+class QextCapture
+{
+public:
+    enum Direction { Rx, Tx };
+
+    QextCapture();
+    ~QextCapture();
+
+    bool start(const QextCaptureOptions &options);
+    void stop();
+    void drain();
+
+    // Called on the I/O paths; never blocks. Each direction must have a
+    // single producer at a time, which the port's threading gives.
+    void append(Direction direction, const char *data, qint64 size);
+
+    QAtomicInt active;
+    QAtomicInt writers;     // producers inside append()
+    QAtomicInteger<quint64> bytesCaptured;
+    QAtomicInteger<quint64> recordsCaptured;
+    QAtomicInteger<quint64> bytesDropped;
+    QAtomicInteger<quint64> recordsDropped;
+    QAtomicInteger<quint64> bytesWritten;
+    QAtomicInteger<quint64> filesWritten;
+
+private:
+    struct IndexEntry
+    {
+        qint64 offset;
+        qint64 first;
+        qint64 last;
+        quint32 records;
+    };
+
+    // pcapng packet being assembled, per direction
+    struct Frame
+    {
+        QByteArray data;
+        qint64 first;
+        qint64 last;
+    };
+
+    bool openFile();
+    void closeFile();
+    void writeBuffer(int direction, QextCaptureBuffer *buffer);
+    void writeBlock(const QextCaptureBuffer *buffer);
+    void writePackets(const QextCaptureBuffer *buffer);
+    void frameData(int direction, qint64 timestamp, const char *data, int size);
+    void writeFrame(int direction);
+
+    QextCaptureStream streams[2];
+    QMutex fileMutex;       // the writer thread against stop()
+    QextCaptureOptions options;
+    QFile file;
+    QByteArray portName;
+    quint32 sequence;
+    QextPcapngFile *pcapng;
+    int interfaceIds[2];
+    Frame frames[2];
+    qint64 wallBase;        // wall clock minus monotonic clock
+    bool writeFailed;
+    QVector<IndexEntry> index;
+    QByteArray scratch;
+};
+
+#endif // _QEXTSERIALCAPTURE_P_H_
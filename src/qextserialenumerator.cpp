@@ -32,21 +32,416 @@
 #include "qextserialenumerator.h"
 #include "qextserialenumerator_p.h"
 
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QDataStream>
 #include <QtCore/QDebug>
+#include <QtCore/QFile>
+#include <QtCore/QFutureInterface>
+#include <QtCore/QHash>
 #include <QtCore/QMetaType>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QPair>
 #include <QtCore/QRegExp>
+#include <QtCore/QRunnable>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+#ifdef Q_OS_UNIX
+#  include <sys/stat.h>
+#endif
+
+/*
+    Enumerations started by getPortsAsync() run one after the other on a single
+    worker, there is no point in walking the same device tree in parallel.
+*/
+class QextEnumerationPool : public QThreadPool
+{
+public:
+    QextEnumerationPool() { setMaxThreadCount(1); }
+};
+
+Q_GLOBAL_STATIC(QextEnumerationPool, enumerationPool)
+
+class QextSerialEnumerateTask : public QRunnable
+{
+public:
+    QextSerialEnumerateTask(const QFutureInterface<QList<QextPortInfo> > &iface,
+                            QextSerialEnumerator::PortDetails details)
+        : iface(iface), details(details) {
+    }
+
+    void run() {
+        QList<QextPortInfo> ports = QextSerialEnumeratorPrivate::getPorts_sys(details);
+        iface.reportResult(ports);
+        iface.reportFinished();
+    }
+
+    QFutureInterface<QList<QextPortInfo> > iface;
+    QextSerialEnumerator::PortDetails details;
+};
+
+/*
+    The port list saved by the previous run, see setSnapshotFile(). The first
+    getPorts() serves it while a real enumeration runs in the background;
+    when that is done the differences are posted to all enumerators and the
+    file is rewritten.
+*/
+class QextPortSnapshot
+{
+public:
+    enum State {
+        Disabled,
+        Enabled,        // file set, nothing served yet
+        Reconciling,    // snapshot served, enumeration running
+        Live            // ports come from the system, file follows changes
+    };
+
+    QextPortSnapshot() : state(Disabled) {}
+
+    bool load();
+    void save();
+    void reconcile(const QList<QextPortInfo> &current, bool notify);
+
+    QMutex mutex;
+    State state;
+    QString fileName;
+    QList<QextPortInfo> ports;
+    QList<QextSerialEnumeratorPrivate *> enumerators;
+};
+
+Q_GLOBAL_STATIC(QextPortSnapshot, portSnapshot)
+
+// hotplug notifications delivered by all enumerators, for writeMetrics()
+static QAtomicInteger<quint64> discoveredNotifications;
+static QAtomicInteger<quint64> removedNotifications;
+
+static const quint32 SnapshotMagic = 0x51455350; // "QESP"
+static const quint16 SnapshotVersion = 1;
+
+/*
+    Identifies the device node behind \a physName. A port whose node was
+    recreated since the snapshot was taken (a replugged adapter gets a new
+    inode, a changed one a new ctime) must not be served from it.
+*/
+static bool nodeIdentity(const QString &physName, quint64 *inode, qint64 *ctimeNsecs)
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(physName).constData(), &st) != 0 || !S_ISCHR(st.st_mode))
+        return false;
+    *inode = quint64(st.st_ino);
+#  ifdef Q_OS_MAC
+    *ctimeNsecs = qint64(st.st_ctimespec.tv_sec) * 1000000000 + st.st_ctimespec.tv_nsec;
+#  else
+    *ctimeNsecs = qint64(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+#  endif
+    return true;
+#else
+    Q_UNUSED(physName);
+    Q_UNUSED(inode);
+    Q_UNUSED(ctimeNsecs);
+    return false;
+#endif
+}
+
+static bool isSameInfo(const QextPortInfo &a, const QextPortInfo &b)
+{
+    return a.portName == b.portName && a.physName == b.physName
+            && a.friendName == b.friendName && a.enumName == b.enumName
+            && a.serialNumber == b.serialNumber && a.locationPath == b.locationPath
+            && a.persistentName == b.persistentName
+            && a.vendorID == b.vendorID && a.productID == b.productID;
+}
+
+/*
+    Appends the ports of \a from that are not in \a to, or differ there, to
+    \a missing. \a index maps the port names of \a to to their positions.
+*/
+static void collectMissing(const QList<QextPortInfo> &from, const QList<QextPortInfo> &to,
+                           const QHash<QString, int> &index, QList<QextPortInfo> *missing)
+{
+    foreach (const QextPortInfo &info, from) {
+        int i = index.value(info.portName, -1);
+        if (i == -1 || !isSameInfo(to.at(i), info))
+            missing->append(info);
+    }
+}
+
+static QHash<QString, int> indexByName(const QList<QextPortInfo> &list)
+{
+    QHash<QString, int> index;
+    index.reserve(list.size());
+    for (int i = 0; i < list.size(); ++i)
+        index.insert(list.at(i).portName, i);
+    return index;
+}
+
+/*
+    Reads the snapshot file, keeping only the ports whose device node is
+    still the one that was recorded. Returns false if there is no usable file.
+*/
+bool QextPortSnapshot::load()
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    quint16 version;
+    quint32 count;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != SnapshotMagic || version != SnapshotVersion)
+        return false;
+
+    QList<QextPortInfo> valid;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QextPortInfo info;
+        qint32 vendorID, productID;
+        quint64 inode, currentInode;
+        qint64 ctime, currentCtime;
+        in >> info.portName >> info.physName >> info.friendName >> info.enumName
+           >> info.serialNumber >> info.locationPath >> info.persistentName
+           >> vendorID >> productID >> inode >> ctime;
+        info.vendorID = vendorID;
+        info.productID = productID;
+        if (nodeIdentity(info.physName, &currentInode, &currentCtime)
+                && currentInode == inode && currentCtime == ctime)
+            valid.append(info);
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+    ports = valid;
+    return true;
+}
+
+void QextPortSnapshot::save()
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QESP_WARNING("QextSerialEnumerator: cannot write snapshot %s", qPrintable(fileName));
+        return;
+    }
+    QList<QextPortInfo> stored;
+    QList<QPair<quint64, qint64> > nodes;
+    foreach (const QextPortInfo &info, ports) {
+        quint64 inode;
+        qint64 ctime;
+        // ports without a device node can not be validated, leave them out
+        if (nodeIdentity(info.physName, &inode, &ctime)) {
+            stored.append(info);
+            nodes.append(qMakePair(inode, ctime));
+        }
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << SnapshotMagic << SnapshotVersion << quint32(stored.size());
+    for (int i = 0; i < stored.size(); ++i) {
+        const QextPortInfo &info = stored.at(i);
+        out << info.portName << info.physName << info.friendName << info.enumName
+            << info.serialNumber << info.locationPath << info.persistentName
+            << qint32(info.vendorID) << qint32(info.productID)
+            << nodes.at(i).first << nodes.at(i).second;
+    }
+    file.commit();
+}
+
+/*
+    Replaces the served list with the real one \a current, rewrites the file
+    if anything differs and, if \a notify is set, tells every enumerator what
+    changed. Only enumerators that set up notifications are told, and those
+    that did so after the snapshot was served only about the removed ports:
+    their setup reported the live ports already. Must be called with the
+    mutex held.
+*/
+void QextPortSnapshot::reconcile(const QList<QextPortInfo> &current, bool notify)
+{
+    QList<QextPortInfo> added;
+    QList<QextPortInfo> removed;
+    collectMissing(ports, current, indexByName(current), &removed);
+    collectMissing(current, ports, indexByName(ports), &added);
+    ports = current;
+    if (added.isEmpty() && removed.isEmpty())
+        return;
+    save();
+    if (!notify)
+        return;
+    foreach (QextSerialEnumeratorPrivate *d, enumerators) {
+        if (!d->notificationsEnabled)
+            continue;
+        if (!d->reportedLivePorts)
+            d->postDeviceChanges(added, removed);
+        else if (!removed.isEmpty())
+            d->postDeviceChanges(QList<QextPortInfo>(), removed);
+    }
+}
+
+class QextSnapshotReconcileTask : public QRunnable
+{
+public:
+    void run() {
+        QList<QextPortInfo> current = QextSerialEnumeratorPrivate::getPorts_sys();
+        QextPortSnapshot *snapshot = portSnapshot();
+        QMutexLocker locker(&snapshot->mutex);
+        snapshot->reconcile(current, true);
+        snapshot->state = QextPortSnapshot::Live;
+    }
+};
 
 QextSerialEnumeratorPrivate::QextSerialEnumeratorPrivate(QextSerialEnumerator *enumrator)
-    :q_ptr(enumrator)
+    :debounceInterval(0), debounceTimer(0), notificationsEnabled(false),
+     reportedLivePorts(false), q_ptr(enumrator)
 {
     init_sys();
+    QextPortSnapshot *snapshot = portSnapshot();
+    QMutexLocker locker(&snapshot->mutex);
+    snapshot->enumerators.append(this);
 }
 
 QextSerialEnumeratorPrivate::~QextSerialEnumeratorPrivate()
 {
+    if (!portSnapshot.isDestroyed()) {
+        QextPortSnapshot *snapshot = portSnapshot();
+        QMutexLocker locker(&snapshot->mutex);
+        snapshot->enumerators.removeOne(this);
+    }
     destroy_sys();
 }
 
+/*
+    Hands changes found outside the enumerator's own thread (the udev port
+    cache, snapshot reconciliation) over to it. Callers may hold their locks,
+    so the changes are always queued.
+*/
+void QextSerialEnumeratorPrivate::postDeviceChanges(const QList<QextPortInfo> &added, const QList<QextPortInfo> &removed)
+{
+    QMetaObject::invokeMethod(q_ptr, [this, added, removed] {
+        foreach (const QextPortInfo &info, removed)
+            queueDeviceChange(info, false);
+        foreach (const QextPortInfo &info, added)
+            queueDeviceChange(info, true);
+        scheduleDeviceChanges();
+    }, Qt::QueuedConnection);
+}
+
+static int indexOfPort(const QList<QextPortInfo> &list, const QString &portName)
+{
+    for (int i = 0; i < list.size(); ++i) {
+        if (list.at(i).portName == portName)
+            return i;
+    }
+    return -1;
+}
+
+static bool isSameDevice(const QextPortInfo &a, const QextPortInfo &b)
+{
+    return a.physName == b.physName && a.vendorID == b.vendorID
+            && a.productID == b.productID && a.serialNumber == b.serialNumber;
+}
+
+/*
+    Records a hotplug event for the next batch. A device that goes away again
+    before the batch is delivered cancels its own arrival, and one that comes
+    back cancels its removal, so flapping connections produce no signals.
+*/
+void QextSerialEnumeratorPrivate::queueDeviceChange(const QextPortInfo &info, bool added)
+{
+    int a = indexOfPort(pendingAdded, info.portName);
+    if (added) {
+        int r = indexOfPort(pendingRemoved, info.portName);
+        if (r != -1 && isSameDevice(pendingRemoved.at(r), info)) {
+            pendingRemoved.removeAt(r);
+            return;
+        }
+        if (a == -1)
+            pendingAdded.append(info);
+        else
+            pendingAdded[a] = info;
+    } else {
+        if (a != -1) {
+            pendingAdded.removeAt(a);
+            return;
+        }
+        if (indexOfPort(pendingRemoved, info.portName) == -1)
+            pendingRemoved.append(info);
+    }
+}
+
+/*
+    Called by the platform code after it has queued everything it received in
+    one go. Without a debounce interval the batch is delivered right away,
+    otherwise once the interval since the first queued event has passed.
+*/
+void QextSerialEnumeratorPrivate::scheduleDeviceChanges()
+{
+    Q_Q(QextSerialEnumerator);
+    if (pendingAdded.isEmpty() && pendingRemoved.isEmpty())
+        return;
+    if (debounceInterval <= 0) {
+        flushDeviceChanges();
+        return;
+    }
+    if (!debounceTimer) {
+        debounceTimer = new QTimer(q);
+        debounceTimer->setSingleShot(true);
+        q->connect(debounceTimer, &QTimer::timeout, q, [this]{flushDeviceChanges();});
+    }
+    if (!debounceTimer->isActive())
+        debounceTimer->start(debounceInterval);
+}
+
+void QextSerialEnumeratorPrivate::flushDeviceChanges()
+{
+    Q_Q(QextSerialEnumerator);
+    if (debounceTimer)
+        debounceTimer->stop();
+    QList<QextPortInfo> added = pendingAdded;
+    QList<QextPortInfo> removed = pendingRemoved;
+    pendingAdded.clear();
+    pendingRemoved.clear();
+    if (added.isEmpty() && removed.isEmpty())
+        return;
+
+    removedNotifications.fetchAndAddRelaxed(removed.size());
+    discoveredNotifications.fetchAndAddRelaxed(added.size());
+    foreach (const QextPortInfo &info, removed)
+        Q_EMIT q->deviceRemoved(info);
+    foreach (const QextPortInfo &info, added)
+        Q_EMIT q->deviceDiscovered(info);
+    Q_EMIT q->devicesChanged(added, removed);
+}
+
+/*
+    Appends the enumerator metrics to \a out in the Prometheus text format,
+    for QextSerialMetricsExporter.
+*/
+void QextSerialEnumeratorPrivate::writeMetrics(QByteArray *out)
+{
+    int instances;
+    {
+        QextPortSnapshot *snapshot = portSnapshot();
+        QMutexLocker locker(&snapshot->mutex);
+        instances = snapshot->enumerators.size();
+    }
+    *out += "# HELP qextserialenumerator_instances Live QextSerialEnumerator objects.\n"
+            "# TYPE qextserialenumerator_instances gauge\n"
+            "qextserialenumerator_instances " + QByteArray::number(instances) + '\n';
+    *out += "# HELP qextserialenumerator_notifications_total Hotplug notifications delivered, summed over enumerators.\n"
+            "# TYPE qextserialenumerator_notifications_total counter\n"
+            "qextserialenumerator_notifications_total{event=\"discovered\"} "
+            + QByteArray::number(discoveredNotifications.load()) + "\n"
+            "qextserialenumerator_notifications_total{event=\"removed\"} "
+            + QByteArray::number(removedNotifications.load()) + '\n';
+    qint64 changes = changeCount_sys();
+    if (changes >= 0) {
+        *out += "# HELP qextserialenumerator_port_list_changes_total Changes to the cached port list.\n"
+                "# TYPE qextserialenumerator_port_list_changes_total counter\n"
+                "qextserialenumerator_port_list_changes_total " + QByteArray::number(changes) + '\n';
+    }
+}
+
 /*!
   \class QextPortInfo
 
@@ -59,11 +454,73 @@ QextSerialEnumeratorPrivate::~QextSerialEnumeratorPrivate()
   QString physName;   ///< Physical name.
   QString friendName; ///< Friendly name.
   QString enumName;   ///< Enumerator name.
+  QString serialNumber; ///< USB Serial number
+  QString locationPath; ///< Physical location (e.g. USB topology), stable across reconnects
+  QString persistentName; ///< Persistent device name, e.g. a /dev/serial/by-id link
   int vendorID;       ///< Vendor ID.
   int productID;      ///< Product ID
   \endcode
+
+  locationPath and persistentName are currently only filled in on Linux.
+ */
+
+/*!
+  \class QextPortFilter
+
+  \brief The QextPortFilter class describes the ports QextSerialEnumerator::findPorts() looks for.
+
+  \code
+  int vendorID;       ///< Vendor ID, -1 matches any.
+  int productID;      ///< Product ID, -1 matches any.
+  QString serialNumber; ///< USB Serial number, empty matches any.
+  QString locationPath; ///< Physical location, empty matches any.
+  QString persistentName; ///< Persistent device name, empty matches any.
+  \endcode
  */
 
+bool QextSerialEnumeratorPrivate::portMatches(const QextPortInfo &info, const QextPortFilter &filter)
+{
+    return (filter.vendorID == -1 || info.vendorID == filter.vendorID)
+            && (filter.productID == -1 || info.productID == filter.productID)
+            && (filter.serialNumber.isEmpty() || info.serialNumber == filter.serialNumber)
+            && (filter.locationPath.isEmpty() || info.locationPath == filter.locationPath)
+            && (filter.persistentName.isEmpty() || info.persistentName == filter.persistentName);
+}
+
+#if !defined(Q_OS_LINUX) || defined(QESP_NO_UDEV)
+/*
+    Without the udev port cache there is nothing to count changes with, and
+    searches go through a full enumeration.
+*/
+qint64 QextSerialEnumeratorPrivate::changeCount_sys()
+{
+    return -1;
+}
+
+QList<QextPortInfo> QextSerialEnumeratorPrivate::findPorts_sys(const QextPortFilter &filter)
+{
+    QList<QextPortInfo> result;
+    foreach (const QextPortInfo &info, getPorts_sys()) {
+        if (portMatches(info, filter))
+            result.append(info);
+    }
+    return result;
+}
+#endif
+
+#ifndef Q_OS_LINUX
+bool QextSerialEnumeratorPrivate::portInfo_sys(const QString &portName, QextPortInfo *info)
+{
+    foreach (const QextPortInfo &port, getPorts_sys()) {
+        if (port.portName == portName || port.physName == portName) {
+            *info = port;
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
 /*! \class QextSerialEnumerator
 
     \brief The QextSerialEnumerator class provides list of ports available in the system.
@@ -82,7 +539,8 @@ QextSerialEnumeratorPrivate::~QextSerialEnumeratorPrivate()
   
     To enable event-driven notification of device connection events, first call
     setUpNotifications() and then connect to the deviceDiscovered() and deviceRemoved()
-    signals.  Event-driven behavior is currently available only on Windows and OS X.
+    signals, or to devicesChanged() to get all changes of one hotplug burst at once.
+    Event-driven behavior is available on Windows, OS X and Linux with udev.
   
     \bold Example
     \code
@@ -93,6 +551,15 @@ QextSerialEnumeratorPrivate::~QextSerialEnumeratorPrivate()
                myClass, SLOT(onDeviceRemoved(const QextPortInfo &)));
     \endcode
   
+    \section1 Synthetic device trees
+    On Linux without udev the ports are read from sysfs. The environment
+    variables QESP_SYSFS_ROOT and QESP_DEV_ROOT replace /sys and /dev, so the
+    enumeration can be run and timed against a generated tree with any number
+    of ports. They are read at the start of every enumeration.
+    benchmarks/enumbench builds such trees and reports latency, allocations
+    and system calls of getPorts(), and with the udev cache also the time
+    from a hotplug event to its signal.
+
     \section1 Credits
     Windows implementation is based on Zach Gorman's work from
     \l {http://www.codeproject.com}{The Code Project} (\l http://www.codeproject.com/system/setupdi.asp).
@@ -107,7 +574,7 @@ QextSerialEnumeratorPrivate::~QextSerialEnumeratorPrivate()
     A new device has been connected to the system.
   
     setUpNotifications() must be called first to enable event-driven device notifications.
-    Currently only implemented on Windows and OS X.
+    Implemented on Windows, OS X and Linux with udev.
   
     \a info The device that has been discovered.
 */
@@ -117,11 +584,24 @@ QextSerialEnumeratorPrivate::~QextSerialEnumeratorPrivate()
     A device has been disconnected from the system.
   
     setUpNotifications() must be called first to enable event-driven device notifications.
-    Currently only implemented on Windows and OS X.
+    Implemented on Windows, OS X and Linux with udev.
   
     \a info The device that was disconnected.
 */
 
+/*!
+   \fn void QextSerialEnumerator::devicesChanged(const QList<QextPortInfo> &added, const QList<QextPortInfo> &removed);
+    Devices have been connected to or disconnected from the system.
+
+    Emitted once per batch of hotplug events, after the deviceRemoved() and
+    deviceDiscovered() signals for the same batch. Devices that were connected
+    and disconnected again within the batch appear in neither list.
+    See setDebounceInterval().
+
+    \a added The devices that have been discovered.
+    \a removed The devices that were disconnected.
+*/
+
 /*!
    Constructs a QextSerialEnumerator object with the given \a parent.
 */
@@ -130,6 +610,8 @@ QextSerialEnumerator::QextSerialEnumerator(QObject *parent)
 {
     if (!QMetaType::isRegistered(QMetaType::type("QextPortInfo")))
         qRegisterMetaType<QextPortInfo>("QextPortInfo");
+    if (!QMetaType::isRegistered(QMetaType::type("QList<QextPortInfo>")))
+        qRegisterMetaType<QList<QextPortInfo> >("QList<QextPortInfo>");
 }
 
 /*!
@@ -144,10 +626,166 @@ QextSerialEnumerator::~QextSerialEnumerator()
     Get list of ports.
 
     return list of ports currently available in the system.
+
+    On Linux with udev the list comes from a process-wide cache that is filled by
+    the first call and afterwards only updated from udev hotplug events, so
+    repeated calls are cheap. See changeCount().
 */
 QList<QextPortInfo> QextSerialEnumerator::getPorts()
 {
-    return QextSerialEnumeratorPrivate::getPorts_sys();
+    QextPortSnapshot *snapshot = portSnapshot();
+    {
+        QMutexLocker locker(&snapshot->mutex);
+        if (snapshot->state == QextPortSnapshot::Enabled) {
+            if (snapshot->load()) {
+                snapshot->state = QextPortSnapshot::Reconciling;
+                enumerationPool()->start(new QextSnapshotReconcileTask);
+                return snapshot->ports;
+            }
+            snapshot->state = QextPortSnapshot::Live;
+        }
+        if (snapshot->state == QextPortSnapshot::Reconciling)
+            return snapshot->ports;
+        if (snapshot->state == QextPortSnapshot::Disabled)
+            return QextSerialEnumeratorPrivate::getPorts_sys();
+    }
+
+    // keep the file current for the next start
+    QList<QextPortInfo> ports = QextSerialEnumeratorPrivate::getPorts_sys();
+    QMutexLocker locker(&snapshot->mutex);
+    snapshot->reconcile(ports, false);
+    return ports;
+}
+
+/*!
+    Makes getPorts() remember its result in \a fileName, a compact binary
+    file, and start from it in the next run of the application: the first
+    getPorts() then returns the saved list at once and enumerates the system
+    on a worker thread. Ports that turn out to be gone or new are reported
+    by all enumerators through deviceRemoved(), deviceDiscovered() and
+    devicesChanged(); until the enumeration has finished, getPorts() keeps
+    returning the saved list.
+
+    Every saved port records inode and change time of its device node; an
+    entry whose node has been recreated or changed since is not served.
+    Ports without a device node in the file system (Windows COM ports) are
+    never saved, so the file has no effect there.
+
+    Must be called before the first getPorts(); an empty \a fileName
+    disables the snapshot.
+*/
+void QextSerialEnumerator::setSnapshotFile(const QString &fileName)
+{
+    QextPortSnapshot *snapshot = portSnapshot();
+    QMutexLocker locker(&snapshot->mutex);
+    snapshot->fileName = fileName;
+    if (fileName.isEmpty())
+        snapshot->state = QextPortSnapshot::Disabled;
+    else if (snapshot->state == QextPortSnapshot::Disabled)
+        snapshot->state = QextPortSnapshot::Enabled;
+}
+
+/*!
+    \overload
+
+    With \a details set to NamesOnly only the names (portName, physName,
+    friendName, enumName) are filled in; vendor and product ID, serial number,
+    location and persistent name are left empty. This skips reading the USB
+    descriptors of every port, use portInfo() to get them for the ports that
+    are actually of interest.
+
+    NamesOnly currently makes a difference on Linux without udev; the udev
+    cache and the other platforms always provide all details.
+*/
+QList<QextPortInfo> QextSerialEnumerator::getPorts(PortDetails details)
+{
+    return QextSerialEnumeratorPrivate::getPorts_sys(details);
+}
+
+/*!
+    Runs getPorts() with \a details on a worker thread and returns a future
+    for the result, so the calling thread, typically the GUI thread, does not
+    block while the system is enumerated. Use a QFutureWatcher to be notified
+    when the list is ready.
+
+    \bold Example
+    \code
+    QFutureWatcher<QList<QextPortInfo> > *watcher = new QFutureWatcher<QList<QextPortInfo> >(this);
+    connect(watcher, SIGNAL(finished()), this, SLOT(onPortsListed()));
+    watcher->setFuture(QextSerialEnumerator::getPortsAsync());
+    \endcode
+*/
+QFuture<QList<QextPortInfo> > QextSerialEnumerator::getPortsAsync(PortDetails details)
+{
+    QFutureInterface<QList<QextPortInfo> > iface;
+    iface.reportStarted();
+    QFuture<QList<QextPortInfo> > future = iface.future();
+    enumerationPool()->start(new QextSerialEnumerateTask(iface, details));
+    return future;
+}
+
+/*!
+    Returns all details of the single port \a portName, which may be given as
+    portName or physName of a QextPortInfo. If there is no such port, the
+    portName of the result is empty.
+
+    \sa getPorts()
+*/
+QextPortInfo QextSerialEnumerator::portInfo(const QString &portName)
+{
+    QextPortInfo info;
+    info.vendorID = 0;
+    info.productID = 0;
+    if (QextSerialEnumeratorPrivate::portInfo_sys(portName, &info))
+        return info;
+
+    QextPortInfo none;
+    none.vendorID = 0;
+    none.productID = 0;
+    return none;
+}
+
+/*!
+    \enum QextSerialEnumerator::PortDetails
+
+    This enum type specifies how much getPorts() finds out about each port:
+
+    \value NamesOnly
+       only the names, see getPorts()
+    \value AllDetails
+       everything QextPortInfo holds
+*/
+
+/*!
+    Returns a counter that increases whenever the list returned by getPorts()
+    changes, so callers polling for ports can skip their work when nothing
+    happened.
+
+    Returns -1 on platforms that do not keep a port cache (currently all but
+    Linux with udev); there every getPorts() call enumerates afresh.
+*/
+qint64 QextSerialEnumerator::changeCount()
+{
+    return QextSerialEnumeratorPrivate::changeCount_sys();
+}
+
+/*!
+    Returns the ports matching all criteria set in \a filter.
+
+    On Linux with udev the lookup goes through hash indexes on vendor/product ID,
+    serial number and location that are kept in step with hotplug events;
+    elsewhere getPorts() is scanned.
+
+    \bold Example
+    \code
+    QextPortFilter filter;
+    filter.serialNumber = "FTDI_FT232R_USB_UART_A600abcd";
+    QList<QextPortInfo> ports = QextSerialEnumerator::findPorts(filter);
+    \endcode
+*/
+QList<QextPortInfo> QextSerialEnumerator::findPorts(const QextPortFilter &filter)
+{
+    return QextSerialEnumeratorPrivate::findPorts_sys(filter);
 }
 
 /*!
@@ -156,8 +794,42 @@ QList<QextPortInfo> QextSerialEnumerator::getPorts()
 void QextSerialEnumerator::setUpNotifications()
 {
     Q_D(QextSerialEnumerator);
-    if (!d->setUpNotifications_sys(true))
+    if (!d->setUpNotifications_sys(true)) {
         QESP_WARNING("Setup Notification Failed...");
+        return;
+    }
+    QextPortSnapshot *snapshot = portSnapshot();
+    QMutexLocker locker(&snapshot->mutex);
+    d->notificationsEnabled = true;
+    // the setup has just reported the live ports, see reconcile()
+    d->reportedLivePorts = snapshot->state == QextPortSnapshot::Reconciling;
+}
+
+/*!
+    Sets the window in which hotplug events are collected before they are
+    delivered to \a msecs milliseconds.
+
+    Connecting a hub with many adapters, or a device whose connection flaps,
+    produces a burst of events. With a debounce interval the events arriving
+    within that window are merged: deviceDiscovered() and deviceRemoved() are
+    only emitted for the net changes, followed by a single devicesChanged().
+    The default of 0 still merges all events read in one wakeup, but delivers
+    them without delay.
+*/
+void QextSerialEnumerator::setDebounceInterval(int msecs)
+{
+    Q_D(QextSerialEnumerator);
+    d->debounceInterval = qMax(0, msecs);
+}
+
+/*!
+    Returns the hotplug debounce interval in milliseconds.
+    \sa setDebounceInterval()
+*/
+int QextSerialEnumerator::debounceInterval() const
+{
+    Q_D(const QextSerialEnumerator);
+    return d->debounceInterval;
 }
 
 #include "moc_qextserialenumerator.cpp"
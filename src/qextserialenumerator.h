@@ -34,6 +34,7 @@
 
 #include <QtCore/QList>
 #include <QtCore/QObject>
+#include <QtCore/QFuture>
 #include "qextserialport_global.h"
 
 struct QextPortInfo {
@@ -42,31 +43,55 @@ struct QextPortInfo {
     QString friendName; ///< Friendly name.
     QString enumName;   ///< Enumerator name.
     QString serialNumber; ///< USB Serial number
+    QString locationPath; ///< Physical location (e.g. USB topology), stable across reconnects
+    QString persistentName; ///< Persistent device name, e.g. a /dev/serial/by-id link
     int vendorID;       ///< Vendor ID.
     int productID;      ///< Product ID
 };
 
+struct QextPortFilter {
+    QextPortFilter() : vendorID(-1), productID(-1) {}
+    int vendorID;       ///< Vendor ID, -1 matches any.
+    int productID;      ///< Product ID, -1 matches any.
+    QString serialNumber; ///< USB Serial number, empty matches any.
+    QString locationPath; ///< Physical location, empty matches any.
+    QString persistentName; ///< Persistent device name, empty matches any.
+};
+
 class QextSerialEnumeratorPrivate;
 class QEXTSERIALPORT_EXPORT QextSerialEnumerator : public QObject
 {
     Q_OBJECT
     Q_DECLARE_PRIVATE(QextSerialEnumerator)
+    Q_ENUMS(PortDetails)
 public:
+    enum PortDetails {
+        NamesOnly,
+        AllDetails
+    };
+
     QextSerialEnumerator(QObject *parent=0);
     ~QextSerialEnumerator();
 
     static QList<QextPortInfo> getPorts();
+    static QList<QextPortInfo> getPorts(PortDetails details);
+    static QFuture<QList<QextPortInfo> > getPortsAsync(PortDetails details = AllDetails);
+    static QextPortInfo portInfo(const QString &portName);
+    static void setSnapshotFile(const QString &fileName);
+    static qint64 changeCount();
+    static QList<QextPortInfo> findPorts(const QextPortFilter &filter);
     void setUpNotifications();
 
+    void setDebounceInterval(int msecs);
+    int debounceInterval() const;
+
 Q_SIGNALS:
     void deviceDiscovered(const QextPortInfo &info);
     void deviceRemoved(const QextPortInfo &info);
+    void devicesChanged(const QList<QextPortInfo> &added, const QList<QextPortInfo> &removed);
 
 private:
     Q_DISABLE_COPY(QextSerialEnumerator)
-#if defined(Q_OS_LINUX) && !defined(QESP_NO_UDEV)
-    Q_PRIVATE_SLOT(d_func(), void _q_deviceEvent())
-#endif
     QextSerialEnumeratorPrivate *d_ptr;
 };
 
@@ -32,40 +32,321 @@
 
 #include "qextserialenumerator.h"
 #include "qextserialenumerator_p.h"
+#include "qextserialtrace_p.h"
 #include <QtCore/QDebug>
 #include <QtCore/QStringList>
 #include <QtCore/QDir>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef QESP_NO_UDEV
+#  include <QtCore/QSocketNotifier>
+#  include <QtCore/QThread>
+#  include <QtCore/QWaitCondition>
+#  include <poll.h>
+
+QESP_DEFINE_PROBE(hotplug)
+#endif
 
 void QextSerialEnumeratorPrivate::init_sys()
 {
 #ifndef QESP_NO_UDEV
-    monitor = NULL;
-    notifierFd = -1;
-    notifier = nullptr;
-
-    udev = udev_new();
-    if (!udev)
-        qCritical() << "Unable to initialize udev notifications";
+    hotplugSubscribed = false;
 #endif
 }
 
-void QextSerialEnumeratorPrivate::destroy_sys()
+#ifdef QESP_NO_UDEV
+/*
+    Fallback for systems without sysfs: guess serial ports from the names in /dev.
+*/
+static QList<QextPortInfo> enumerateDevPorts()
 {
-#ifndef QESP_NO_UDEV
-    if (notifier) {
-        notifier->setEnabled(false);
-        delete notifier;
+    QList<QextPortInfo> infoList;
+    QStringList portNamePrefixes, portNameList;
+    portNamePrefixes << QLatin1String("ttyS*"); // list normal serial ports first
+
+    QDir dir(QLatin1String("/dev"));
+    portNameList = dir.entryList(portNamePrefixes, (QDir::System | QDir::Files), QDir::Name);
+
+    // remove the values which are not serial ports for e.g.  /dev/ttysa
+    for (int i = 0; i < portNameList.size(); i++) {
+        bool ok;
+        QString current = portNameList.at(i);
+        // remove the ttyS part, and check, if the other part is a number
+        current.remove(0,4).toInt(&ok, 10);
+        if (!ok) {
+            portNameList.removeAt(i);
+            i--;
+        }
     }
 
-    if (monitor)
-        udev_monitor_unref(monitor);
+    // get the non standard serial ports names
+    // (USB-serial, bluetooth-serial, 18F PICs, and so on)
+    // if you know an other name prefix for serial ports please let us know
+    portNamePrefixes.clear();
+    portNamePrefixes << QLatin1String("ttyACM*") << QLatin1String("ttyUSB*") << QLatin1String("rfcomm*");
+    portNameList += dir.entryList(portNamePrefixes, (QDir::System | QDir::Files), QDir::Name);
+
+    foreach (QString str , portNameList) {
+        QextPortInfo inf;
+        inf.physName = QLatin1String("/dev/")+str;
+        inf.portName = str;
+
+        if (str.contains(QLatin1String("ttyS"))) {
+            inf.friendName = QLatin1String("Serial port ")+str.remove(0, 4);
+        }
+        else if (str.contains(QLatin1String("ttyUSB"))) {
+            inf.friendName = QLatin1String("USB-serial adapter ")+str.remove(0, 6);
+        }
+        else if (str.contains(QLatin1String("rfcomm"))) {
+            inf.friendName = QLatin1String("Bluetooth-serial adapter ")+str.remove(0, 6);
+        }
+        inf.enumName = QLatin1String("/dev"); // is there a more helpful name for this?
+        infoList.append(inf);
+    }
+    return infoList;
+}
 
-    if (udev)
-        udev_unref(udev);
 #endif
+
+static QByteArray readSysfsAttribute(int dirFd, const char *name)
+{
+    char buf[256];
+    int fd = ::openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return QByteArray();
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    ::close(fd);
+    if (n <= 0)
+        return QByteArray();
+    return QByteArray(buf, int(n)).trimmed();
 }
 
+/*
+    \a dirFd refers to a tty's sysfs directory. Virtual terminals, pseudo
+    terminals and the console have no device with a bound driver; serial core
+    ports that were registered without hardware behind them report type 0
+    (PORT_UNKNOWN).
+*/
+static bool isSerialDevice(int dirFd)
+{
+    if (::faccessat(dirFd, "device/driver", F_OK, 0) != 0)
+        return false;
+    return readSysfsAttribute(dirFd, "type") != "0";
+}
+
+#ifdef QESP_NO_UDEV
+/*
+    Roots of the sysfs and device trees. They can be pointed at a synthetic tree
+    through QESP_SYSFS_ROOT and QESP_DEV_ROOT, which allows exercising and
+    timing the enumeration without real hardware. Both are read at the start
+    of every enumeration, so a benchmark can switch between trees of different
+    size within one process.
+*/
+static QByteArray sysfsRoot()
+{
+    QByteArray root = qgetenv("QESP_SYSFS_ROOT");
+    return root.isEmpty() ? QByteArray("/sys") : root;
+}
+
+static QByteArray devRoot()
+{
+    QByteArray root = qgetenv("QESP_DEV_ROOT");
+    return root.isEmpty() ? QByteArray("/dev") : root;
+}
+
+/*
+    Walks up from the tty's device to the USB device it belongs to, if any, and
+    fills in vendor, product and serial number from its attributes. The
+    location is the device path below /sys/devices, which only depends on
+    where the hardware is plugged in.
+*/
+static void readUsbAttributes(const QByteArray &root, const QByteArray &ttyPath, QextPortInfo *info)
+{
+    char resolved[PATH_MAX];
+    if (!::realpath((ttyPath + "/device").constData(), resolved))
+        return;
+
+    QByteArray path(resolved);
+    const QByteArray devicesPath = root + "/devices/";
+    if (path.startsWith(devicesPath))
+        info->locationPath = QString::fromLocal8Bit(path.mid(devicesPath.size()));
+    for (int depth = 0; depth < 8 && path.size() > root.size() && path.startsWith(root); ++depth) {
+        int fd = ::open(path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd != -1) {
+            bool found = ::faccessat(fd, "idVendor", F_OK, 0) == 0;
+            if (found) {
+                info->vendorID = readSysfsAttribute(fd, "idVendor").toInt(0, 16);
+                info->productID = readSysfsAttribute(fd, "idProduct").toInt(0, 16);
+                info->serialNumber = QString::fromLatin1(readSysfsAttribute(fd, "serial"));
+            }
+            ::close(fd);
+            if (found)
+                return;
+        }
+        path.truncate(path.lastIndexOf('/'));
+    }
+}
+
+static QString friendlyName(const QString &name)
+{
+    QString number = name;
+    if (name.startsWith(QLatin1String("ttyS")))
+        return QLatin1String("Serial port ")+number.remove(0, 4);
+    if (name.startsWith(QLatin1String("ttyUSB")))
+        return QLatin1String("USB-serial adapter ")+number.remove(0, 6);
+    if (name.startsWith(QLatin1String("ttyACM")))
+        return QLatin1String("USB modem ")+number.remove(0, 6);
+    if (name.startsWith(QLatin1String("rfcomm")))
+        return QLatin1String("Bluetooth-serial adapter ")+number.remove(0, 6);
+    return QString();
+}
+
+/*
+    Maps port names to their persistent /dev/serial/by-id links, as created by
+    the udev rules of the distribution.
+*/
+static QHash<QString, QString> persistentNames(const QByteArray &dev)
+{
+    QHash<QString, QString> names;
+    const QByteArray byIdPath = dev + "/serial/by-id";
+    DIR *dir = ::opendir(byIdPath.constData());
+    if (!dir)
+        return names;
+
+    int dirFd = ::dirfd(dir);
+    while (struct dirent *entry = ::readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
+        char target[PATH_MAX];
+        ssize_t n = ::readlinkat(dirFd, entry->d_name, target, sizeof(target) - 1);
+        if (n <= 0)
+            continue;
+        target[n] = '\0';
+        const char *base = ::strrchr(target, '/');
+        names.insert(QString::fromLocal8Bit(base ? base + 1 : target),
+                     QString::fromLocal8Bit(byIdPath + '/' + entry->d_name));
+    }
+    ::closedir(dir);
+    return names;
+}
+
+static bool portNameLessThan(const QextPortInfo &a, const QextPortInfo &b)
+{
+    return a.portName < b.portName;
+}
+
+/*
+    What one enumeration needs to know about the trees, worked out once
+    instead of for every port.
+*/
+struct SysfsScan
+{
+    explicit SysfsScan(bool details)
+        : sysRoot(sysfsRoot()), classPath(sysRoot + "/class/tty"), details(details)
+    {
+        const QByteArray dev = devRoot();
+        devPrefix = QString::fromLocal8Bit(dev) + QLatin1Char('/');
+        if (details)
+            links = persistentNames(dev);
+    }
+
+    QByteArray sysRoot;
+    QByteArray classPath;
+    QString devPrefix;
+    QHash<QString, QString> links;
+    bool details;
+};
+
+/*
+    Fills \a inf for the tty \a name below \a classFd (/sys/class/tty).
+    Names are cheap; the USB attributes and persistent names cost a walk up
+    the device tree and are only read if the scan asks for details.
+    Returns false if \a name is not a serial port.
+*/
+static bool sysfsPortInfo(const SysfsScan &scan, int classFd, const char *name, QextPortInfo *inf)
+{
+    int ttyFd = ::openat(classFd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (ttyFd == -1)
+        return false;
+    bool serial = isSerialDevice(ttyFd);
+    ::close(ttyFd);
+    if (!serial)
+        return false;
+
+    inf->portName = QString::fromLocal8Bit(name);
+    inf->physName = scan.devPrefix + inf->portName;
+    inf->friendName = friendlyName(inf->portName);
+    inf->enumName = QLatin1String("/sys/class/tty");
+    inf->vendorID = 0;
+    inf->productID = 0;
+    if (scan.details) {
+        inf->persistentName = scan.links.value(inf->portName);
+        readUsbAttributes(scan.sysRoot, scan.classPath + '/' + name, inf);
+    }
+    return true;
+}
+
+/*
+    Lists the ttys in /sys/class/tty that are backed by a real device. Only a
+    few openat()/read() calls per port, no udev needed.
+    Returns false if sysfs is not available.
+*/
+static bool enumerateSysfsPorts(QList<QextPortInfo> *infoList, bool details)
+{
+    const SysfsScan scan(details);
+    DIR *dir = ::opendir(scan.classPath.constData());
+    if (!dir)
+        return false;
+
+    int classFd = ::dirfd(dir);
+    while (struct dirent *entry = ::readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
+        QextPortInfo inf;
+        if (sysfsPortInfo(scan, classFd, entry->d_name, &inf))
+            infoList->append(inf);
+    }
+    ::closedir(dir);
+
+    std::sort(infoList->begin(), infoList->end(), portNameLessThan);
+    return true;
+}
+
+static bool lookupSysfsPort(const QString &portName, QextPortInfo *info)
+{
+    QString name = portName;
+    int slash = name.lastIndexOf(QLatin1Char('/'));
+    if (slash != -1)
+        name.remove(0, slash + 1);
+    const SysfsScan scan(true);
+    int classFd = ::open(scan.classPath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (classFd == -1)
+        return false;
+    bool found = sysfsPortInfo(scan, classFd, name.toLocal8Bit().constData(), info);
+    ::close(classFd);
+    return found;
+}
+#endif
+
 #ifndef QESP_NO_UDEV
+static bool isSerialDevice(const char *sysPath)
+{
+    int fd = ::open(sysPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    bool serial = isSerialDevice(fd);
+    ::close(fd);
+    return serial;
+}
+
 static QextPortInfo portInfoFromDevice(struct udev_device *dev)
 {
     QString vendor = QString::fromLatin1(udev_device_get_property_value(dev, "ID_VENDOR_ID"));
@@ -78,21 +359,23 @@ static QextPortInfo portInfoFromDevice(struct udev_device *dev)
     pi.portName = QString::fromLatin1(udev_device_get_devnode(dev));
     pi.physName = pi.portName;
     pi.serialNumber = serial;
+    pi.locationPath = QString::fromLatin1(udev_device_get_property_value(dev, "ID_PATH"));
+
+    struct udev_list_entry *link;
+    udev_list_entry_foreach(link, udev_device_get_devlinks_list_entry(dev)) {
+        const char *name = udev_list_entry_get_name(link);
+        if (qstrncmp(name, "/dev/serial/by-id/", 18) == 0) {
+            pi.persistentName = QString::fromLatin1(name);
+            break;
+        }
+    }
 
     return pi;
 }
-#endif
 
-QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys()
+static QList<QextPortInfo> enumeratePorts(struct udev *ud)
 {
     QList<QextPortInfo> infoList;
-#ifndef QESP_NO_UDEV
-    struct udev *ud = udev_new();
-    if (!ud) {
-        qCritical() << "Unable to enumerate ports because udev is not initialized.";
-        return infoList;
-    }
-
     struct udev_enumerate *enumerate = udev_enumerate_new(ud);
     udev_enumerate_add_match_subsystem(enumerate, "tty");
     udev_enumerate_scan_devices(enumerate);
@@ -102,8 +385,12 @@ QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys()
         const char *path;
         struct udev_device *dev;
 
-        // Have to grab the actual udev device here...
+        // Skip virtual terminals and friends before paying for a udev device
         path = udev_list_entry_get_name(entry);
+        if (!isSerialDevice(path))
+            continue;
+
+        // Have to grab the actual udev device here...
         dev = udev_device_new_from_syspath(ud, path);
 
         infoList.append(portInfoFromDevice(dev));
@@ -111,55 +398,437 @@ QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys()
         // Done with this device
         udev_device_unref(dev);
     }
-    // Done with the list and this udev
+    // Done with the list
     udev_enumerate_unref(enumerate);
-    udev_unref(ud);
-#else
-    QStringList portNamePrefixes, portNameList;
-    portNamePrefixes << QLatin1String("ttyS*"); // list normal serial ports first
+    return infoList;
+}
 
-    QDir dir(QLatin1String("/dev"));
-    portNameList = dir.entryList(portNamePrefixes, (QDir::System | QDir::Files), QDir::Name);
+/*
+    Process-wide list of ports. It is filled by one enumeration and afterwards
+    kept current by applying the add/remove events queued on its own udev
+    monitor, so getPorts() does not have to walk the tty subsystem every time.
+    The monitor is only drained when the cache is asked for something, no event
+    loop is required.
+    Vendor/product ID, serial number and location are indexed, so findPorts()
+    does not have to look at every port.
 
-    // remove the values which are not serial ports for e.g.  /dev/ttysa
-    for (int i = 0; i < portNameList.size(); i++) {
-        bool ok;
-        QString current = portNameList.at(i);
-        // remove the ttyS part, and check, if the other part is a number
-        current.remove(0,4).toInt(&ok, 10);
-        if (!ok) {
-            portNameList.removeAt(i);
-            i--;
+    The same monitor serves all enumerators that set up notifications: the
+    first subscriber starts a thread that watches it, whatever thread the
+    subscribers live in, and the last one stops it again; a subscriber that
+    comes while it is being stopped waits for that. Whoever drains the
+    monitor, that thread or a getPorts() call, posts the resulting changes to
+    every subscriber.
+*/
+class QextPortCache;
+
+class QextUdevMonitorThread : public QThread
+{
+public:
+    QextUdevMonitorThread(QextPortCache *cache, int fd) : cache(cache), fd(fd) {}
+
+protected:
+    void run();
+
+private:
+    QextPortCache *cache;
+    int fd;
+};
+
+class QextPortCache
+{
+public:
+    QextPortCache();
+    ~QextPortCache();
+
+    QList<QextPortInfo> ports();
+    qint64 changeCount();
+    QList<QextPortInfo> find(const QextPortFilter &filter);
+    bool lookup(const QString &portName, QextPortInfo *info);
+
+    bool subscribe(QextSerialEnumeratorPrivate *d, QList<QextPortInfo> *snapshot);
+    void unsubscribe(QextSerialEnumeratorPrivate *d);
+
+private:
+    friend class QextUdevMonitorThread;
+    void monitorActivated();
+    static void stopMonitorThread(QextUdevMonitorThread *thread);
+
+    void update();
+    void populate();
+    void processPendingEvents();
+    void resync(QList<QextPortInfo> *added, QList<QextPortInfo> *removed);
+    void applyEvent(struct udev_device *dev, QList<QextPortInfo> *added, QList<QextPortInfo> *removed);
+    int indexOf(const QString &portName) const;
+    void addToIndex(const QextPortInfo &info);
+    void removeFromIndex(const QextPortInfo &info);
+    void rebuildPortIndex();
+
+    static quint32 idKey(int vendorID, int productID)
+    { return (quint32(vendorID & 0xffff) << 16) | quint32(productID & 0xffff); }
+
+    QMutex mutex;
+    struct udev *udev;
+    struct udev_monitor *monitor;
+    bool populated;
+    qint64 changes;
+    QList<QextPortInfo> portList;
+    // portName -> position in portList
+    QHash<QString, int> portIndex;
+    // index key -> portName
+    QMultiHash<quint32, QString> byId;
+    QMultiHash<QString, QString> bySerial;
+    QMultiHash<QString, QString> byLocation;
+    QList<QextSerialEnumeratorPrivate *> subscribers;
+    QextUdevMonitorThread *monitorThread;
+    // set while unsubscribe() stops the thread, see subscribe()
+    bool monitorStopping;
+    QWaitCondition monitorStopped;
+};
+
+Q_GLOBAL_STATIC(QextPortCache, portCache)
+
+QextPortCache::QextPortCache()
+    : udev(udev_new()), monitor(NULL), populated(false), changes(0), monitorThread(0),
+      monitorStopping(false)
+{
+}
+
+QextPortCache::~QextPortCache()
+{
+    stopMonitorThread(monitorThread);
+    if (monitor)
+        udev_monitor_unref(monitor);
+    if (udev)
+        udev_unref(udev);
+}
+
+QList<QextPortInfo> QextPortCache::ports()
+{
+    QMutexLocker locker(&mutex);
+    update();
+    return portList;
+}
+
+qint64 QextPortCache::changeCount()
+{
+    QMutexLocker locker(&mutex);
+    update();
+    return changes;
+}
+
+QList<QextPortInfo> QextPortCache::find(const QextPortFilter &filter)
+{
+    QMutexLocker locker(&mutex);
+    update();
+
+    // Start from the most selective index available
+    QList<QString> candidates;
+    if (!filter.serialNumber.isEmpty()) {
+        candidates = bySerial.values(filter.serialNumber);
+    } else if (!filter.locationPath.isEmpty()) {
+        candidates = byLocation.values(filter.locationPath);
+    } else if (filter.vendorID != -1 && filter.productID != -1) {
+        candidates = byId.values(idKey(filter.vendorID, filter.productID));
+    } else {
+        QList<QextPortInfo> result;
+        foreach (const QextPortInfo &info, portList) {
+            if (QextSerialEnumeratorPrivate::portMatches(info, filter))
+                result.append(info);
         }
+        return result;
     }
 
-    // get the non standard serial ports names
-    // (USB-serial, bluetooth-serial, 18F PICs, and so on)
-    // if you know an other name prefix for serial ports please let us know
-    portNamePrefixes.clear();
-    portNamePrefixes << QLatin1String("ttyACM*") << QLatin1String("ttyUSB*") << QLatin1String("rfcomm*");
-    portNameList += dir.entryList(portNamePrefixes, (QDir::System | QDir::Files), QDir::Name);
+    QList<QextPortInfo> result;
+    foreach (const QString &portName, candidates) {
+        int i = indexOf(portName);
+        if (i != -1 && QextSerialEnumeratorPrivate::portMatches(portList.at(i), filter))
+            result.append(portList.at(i));
+    }
+    return result;
+}
 
-    foreach (QString str , portNameList) {
-        QextPortInfo inf;
-        inf.physName = QLatin1String("/dev/")+str;
-        inf.portName = str;
+/*
+    Registers \a d for hotplug changes and returns the current ports in
+    \a snapshot, both under the same lock so no event is missed or reported
+    twice.
+*/
+bool QextPortCache::subscribe(QextSerialEnumeratorPrivate *d, QList<QextPortInfo> *snapshot)
+{
+    QMutexLocker locker(&mutex);
+    update();
+    if (!monitor) {
+        qCritical() << "Unable to initialize notifications because udev is not initialized.";
+        return false;
+    }
 
-        if (str.contains(QLatin1String("ttyS"))) {
-            inf.friendName = QLatin1String("Serial port ")+str.remove(0, 4);
+    *snapshot = portList;
+    subscribers.append(d);
+    // never two threads on the monitor
+    while (monitorStopping)
+        monitorStopped.wait(&mutex);
+    if (!monitorThread) {
+        monitorThread = new QextUdevMonitorThread(this, udev_monitor_get_fd(monitor));
+        monitorThread->start(QThread::LowPriority);
+    }
+    return true;
+}
+
+void QextPortCache::unsubscribe(QextSerialEnumeratorPrivate *d)
+{
+    QextUdevMonitorThread *thread = 0;
+    {
+        QMutexLocker locker(&mutex);
+        subscribers.removeOne(d);
+        if (subscribers.isEmpty() && monitorThread) {
+            thread = monitorThread;
+            monitorThread = 0;
+            monitorStopping = true;
         }
-        else if (str.contains(QLatin1String("ttyUSB"))) {
-            inf.friendName = QLatin1String("USB-serial adapter ")+str.remove(0, 6);
+    }
+    if (!thread)
+        return;
+    // outside the lock, the thread may be waiting for it
+    stopMonitorThread(thread);
+    QMutexLocker locker(&mutex);
+    monitorStopping = false;
+    monitorStopped.wakeAll();
+}
+
+void QextPortCache::monitorActivated()
+{
+    QMutexLocker locker(&mutex);
+    update();
+}
+
+void QextPortCache::stopMonitorThread(QextUdevMonitorThread *thread)
+{
+    if (!thread)
+        return;
+    thread->quit();
+    thread->wait();
+    delete thread;
+}
+
+void QextUdevMonitorThread::run()
+{
+    QSocketNotifier notifier(fd, QSocketNotifier::Read);
+    QObject::connect(&notifier, &QSocketNotifier::activated, &notifier, [this] {
+        cache->monitorActivated();
+    });
+    exec();
+}
+
+/*
+    \a portName may be given with or without the /dev/ prefix.
+*/
+bool QextPortCache::lookup(const QString &portName, QextPortInfo *info)
+{
+    QMutexLocker locker(&mutex);
+    update();
+    int i = indexOf(portName);
+    if (i == -1 && !portName.startsWith(QLatin1Char('/')))
+        i = indexOf(QLatin1String("/dev/") + portName);
+    if (i == -1)
+        return false;
+    *info = portList.at(i);
+    return true;
+}
+
+void QextPortCache::update()
+{
+    if (!populated)
+        populate();
+    else
+        processPendingEvents();
+}
+
+void QextPortCache::populate()
+{
+    if (!udev) {
+        qCritical() << "Unable to enumerate ports because udev is not initialized.";
+        return;
+    }
+
+    // Start listening before enumerating, so no device slips through in between.
+    if (!monitor) {
+        monitor = udev_monitor_new_from_netlink(udev, "udev");
+        if (monitor) {
+            udev_monitor_filter_add_match_subsystem_devtype(monitor, "tty", NULL);
+            if (udev_monitor_enable_receiving(monitor) < 0) {
+                udev_monitor_unref(monitor);
+                monitor = NULL;
+            }
         }
-        else if (str.contains(QLatin1String("rfcomm"))) {
-            inf.friendName = QLatin1String("Bluetooth-serial adapter ")+str.remove(0, 6);
+    }
+
+    portList = enumeratePorts(udev);
+    byId.clear();
+    bySerial.clear();
+    byLocation.clear();
+    foreach (const QextPortInfo &info, portList)
+        addToIndex(info);
+    rebuildPortIndex();
+    ++changes;
+    // Without a monitor the list cannot be kept current, enumerate every time.
+    populated = (monitor != NULL);
+}
+
+void QextPortCache::processPendingEvents()
+{
+    QList<QextPortInfo> added;
+    QList<QextPortInfo> removed;
+    struct pollfd pfd;
+    pfd.fd = udev_monitor_get_fd(monitor);
+    pfd.events = POLLIN;
+    while (::poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        struct udev_device *dev = udev_monitor_receive_device(monitor);
+        if (!dev) {
+            // the socket overflowed (ENOBUFS) or a message was lost: events
+            // are missing, so enumerate again and report the difference
+            resync(&added, &removed);
+            break;
         }
-        inf.enumName = QLatin1String("/dev"); // is there a more helpful name for this?
-        infoList.append(inf);
+        applyEvent(dev, &added, &removed);
+        udev_device_unref(dev);
     }
+
+    if (added.isEmpty() && removed.isEmpty())
+        return;
+    foreach (QextSerialEnumeratorPrivate *d, subscribers)
+        d->postDeviceChanges(added, removed);
+}
+
+/*
+    Enumerates the ports again and appends what appeared and disappeared
+    since the list was last current to \a added and \a removed.
+*/
+void QextPortCache::resync(QList<QextPortInfo> *added, QList<QextPortInfo> *removed)
+{
+    QHash<QString, int> before;
+    for (int i = 0; i < portList.size(); ++i)
+        before.insert(portList.at(i).portName, i);
+    QList<QextPortInfo> previous = portList;
+    populate();
+    foreach (const QextPortInfo &info, portList) {
+        if (!before.remove(info.portName))
+            added->append(info);
+    }
+    foreach (int i, before)
+        removed->append(previous.at(i));
+}
+
+/*
+    Updates the list from one udev event. Ports that appear or disappear are
+    appended to \a added and \a removed; a change event on a known port is not
+    reported.
+*/
+void QextPortCache::applyEvent(struct udev_device *dev, QList<QextPortInfo> *added, QList<QextPortInfo> *removed)
+{
+    const char *action = udev_device_get_action(dev);
+    if (!action)
+        return;
+    QESP_PROBE2(hotplug, action, udev_device_get_devnode(dev));
+    QextPortInfo pi = portInfoFromDevice(dev);
+    int i = indexOf(pi.portName);
+    if ((qstrcmp(action, "add") == 0 || qstrcmp(action, "change") == 0)
+            && isSerialDevice(udev_device_get_syspath(dev))) {
+        if (i == -1) {
+            portIndex.insert(pi.portName, portList.size());
+            portList.append(pi);
+            added->append(pi);
+        } else {
+            removeFromIndex(portList.at(i));
+            portList[i] = pi;
+        }
+        addToIndex(pi);
+        ++changes;
+    } else if (qstrcmp(action, "remove") == 0 && i != -1) {
+        removeFromIndex(portList.at(i));
+        removed->append(portList.takeAt(i));
+        rebuildPortIndex();
+        ++changes;
+    }
+}
+
+void QextPortCache::addToIndex(const QextPortInfo &info)
+{
+    byId.insert(idKey(info.vendorID, info.productID), info.portName);
+    if (!info.serialNumber.isEmpty())
+        bySerial.insert(info.serialNumber, info.portName);
+    if (!info.locationPath.isEmpty())
+        byLocation.insert(info.locationPath, info.portName);
+}
+
+void QextPortCache::removeFromIndex(const QextPortInfo &info)
+{
+    byId.remove(idKey(info.vendorID, info.productID), info.portName);
+    bySerial.remove(info.serialNumber, info.portName);
+    byLocation.remove(info.locationPath, info.portName);
+}
+
+void QextPortCache::rebuildPortIndex()
+{
+    portIndex.clear();
+    portIndex.reserve(portList.size());
+    for (int i = 0; i < portList.size(); ++i)
+        portIndex.insert(portList.at(i).portName, i);
+}
+
+int QextPortCache::indexOf(const QString &portName) const
+{
+    return portIndex.value(portName, -1);
+}
 #endif
 
+QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys(QextSerialEnumerator::PortDetails details)
+{
+#ifndef QESP_NO_UDEV
+    // the cache holds the details anyway
+    Q_UNUSED(details);
+    return portCache()->ports();
+#else
+    QList<QextPortInfo> infoList;
+    if (!enumerateSysfsPorts(&infoList, details == QextSerialEnumerator::AllDetails))
+        infoList = enumerateDevPorts();
     return infoList;
+#endif
+}
+
+bool QextSerialEnumeratorPrivate::portInfo_sys(const QString &portName, QextPortInfo *info)
+{
+#ifndef QESP_NO_UDEV
+    return portCache()->lookup(portName, info);
+#else
+    if (lookupSysfsPort(portName, info))
+        return true;
+    foreach (const QextPortInfo &port, enumerateDevPorts()) {
+        if (port.portName == portName || port.physName == portName) {
+            *info = port;
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+#ifndef QESP_NO_UDEV
+qint64 QextSerialEnumeratorPrivate::changeCount_sys()
+{
+    return portCache()->changeCount();
+}
+
+QList<QextPortInfo> QextSerialEnumeratorPrivate::findPorts_sys(const QextPortFilter &filter)
+{
+    return portCache()->find(filter);
+}
+#endif
+
+void QextSerialEnumeratorPrivate::destroy_sys()
+{
+#ifndef QESP_NO_UDEV
+    if (hotplugSubscribed)
+        portCache()->unsubscribe(this);
+#endif
 }
 
 bool QextSerialEnumeratorPrivate::setUpNotifications_sys(bool setup)
@@ -167,46 +836,22 @@ bool QextSerialEnumeratorPrivate::setUpNotifications_sys(bool setup)
     Q_UNUSED(setup);
 #ifndef QESP_NO_UDEV
     Q_Q(QextSerialEnumerator);
-    if (!udev) {
-        qCritical() << "Unable to initialize notifications because udev is not initialized.";
+    if (hotplugSubscribed)
+        return true;
+
+    // All enumerators share the monitor of the port cache
+    QList<QextPortInfo> ports;
+    if (!portCache()->subscribe(this, &ports))
         return false;
-    }
+    hotplugSubscribed = true;
 
     // Emit signals immediately for devices already connected (Windows version seems to behave
     // this way)
-    foreach (QextPortInfo i, getPorts_sys())
+    foreach (QextPortInfo i, ports)
         Q_EMIT q->deviceDiscovered(i);
 
-    // Look for tty devices from udev.
-    monitor = udev_monitor_new_from_netlink(udev, "udev");
-    udev_monitor_filter_add_match_subsystem_devtype(monitor, "tty", NULL);
-    udev_monitor_enable_receiving(monitor);
-    notifierFd = udev_monitor_get_fd(monitor);
-    notifier = new QSocketNotifier(notifierFd, QSocketNotifier::Read, q);
-    q->connect(notifier, &QSocketNotifier::activated, q, [this]{_q_deviceEvent();});
-    notifier->setEnabled(true);
-
     return true;
 #else
     return false;
 #endif
 }
-
-#ifndef QESP_NO_UDEV
-void QextSerialEnumeratorPrivate::_q_deviceEvent()
-{
-    Q_Q(QextSerialEnumerator);
-    struct udev_device *dev = udev_monitor_receive_device(monitor);
-    if (dev) {
-        QextPortInfo pi = portInfoFromDevice(dev);
-        QLatin1String action(udev_device_get_action(dev));
-
-        if (action == QLatin1String("add"))
-            Q_EMIT q->deviceDiscovered(pi);
-        else if (action == QLatin1String("remove"))
-            Q_EMIT q->deviceRemoved(pi);
-
-        udev_device_unref(dev);
-    }
-}
-#endif
@@ -48,8 +48,9 @@ void QextSerialEnumeratorPrivate::destroy_sys()
 }
 
 // static
-QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys()
+QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys(QextSerialEnumerator::PortDetails details)
 {
+    Q_UNUSED(details);
     QList<QextPortInfo> infoList;
     io_iterator_t serialPortIterator = 0;
     kern_return_t kernResult = KERN_FAILURE;
@@ -214,7 +215,6 @@ void deviceTerminatedCallbackOSX(void *ctxt, io_iterator_t serialPortIterator)
 */
 void QextSerialEnumeratorPrivate::onDeviceDiscoveredOSX(io_object_t service)
 {
-    Q_Q(QextSerialEnumerator);
     QextPortInfo info;
     info.vendorID = 0;
     info.productID = 0;
@@ -223,8 +223,9 @@ void QextSerialEnumeratorPrivate::onDeviceDiscoveredOSX(io_object_t service)
         // when devices are first enumerated. 500ms is an arbitrary value chosen
         // through experimentation (100ms was too short).
         static const int delay = QSysInfo::MacintoshVersion >= QSysInfo::MV_ELCAPITAN ? 500 : 0;
-        QTimer::singleShot(delay, [=]{
-            Q_EMIT q->deviceDiscovered(info);
+        QTimer::singleShot(delay, q_func(), [=]{
+            queueDeviceChange(info, true);
+            scheduleDeviceChanges();
         });
     }
 }
@@ -235,12 +236,13 @@ void QextSerialEnumeratorPrivate::onDeviceDiscoveredOSX(io_object_t service)
 */
 void QextSerialEnumeratorPrivate::onDeviceTerminatedOSX(io_object_t service)
 {
-    Q_Q(QextSerialEnumerator);
     QextPortInfo info;
     info.vendorID = 0;
     info.productID = 0;
-    if (getServiceDetailsOSX(service, &info))
-        Q_EMIT q->deviceRemoved(info);
+    if (getServiceDetailsOSX(service, &info)) {
+        queueDeviceChange(info, false);
+        scheduleDeviceChanges();
+    }
 }
 
 /*
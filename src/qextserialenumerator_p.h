@@ -67,13 +67,12 @@
 #endif /*Q_OS_MAC*/
 
 #if defined(Q_OS_LINUX) && !defined(QESP_NO_UDEV)
-#  include <QSocketNotifier>
-#  include <QPointer>
 extern "C" {
 #  include <libudev.h>
 }
 #endif
 
+class QTimer;
 class QextSerialRegistrationWidget;
 class QextSerialEnumeratorPrivate
 {
@@ -84,9 +83,27 @@ public:
     void init_sys();
     void destroy_sys();
 
-    static QList<QextPortInfo> getPorts_sys();
+    static QList<QextPortInfo> getPorts_sys(QextSerialEnumerator::PortDetails details = QextSerialEnumerator::AllDetails);
+    static bool portInfo_sys(const QString &portName, QextPortInfo *info);
+    static qint64 changeCount_sys();
+    static QList<QextPortInfo> findPorts_sys(const QextPortFilter &filter);
+    static bool portMatches(const QextPortInfo &info, const QextPortFilter &filter);
+    static void writeMetrics(QByteArray *out);
     bool setUpNotifications_sys(bool setup);
 
+    void queueDeviceChange(const QextPortInfo &info, bool added);
+    void postDeviceChanges(const QList<QextPortInfo> &added, const QList<QextPortInfo> &removed);
+    void scheduleDeviceChanges();
+    void flushDeviceChanges();
+
+    int debounceInterval;
+    QTimer *debounceTimer;
+    QList<QextPortInfo> pendingAdded;
+    QList<QextPortInfo> pendingRemoved;
+    // set by setUpNotifications(), guarded by the snapshot mutex
+    bool notificationsEnabled;
+    bool reportedLivePorts;     // set up while the snapshot was served
+
 #if defined(Q_OS_WIN) && defined(QT_GUI_LIB)
     QextSerialRegistrationWidget *notificationWidget;
     void rescanDevices();
@@ -108,12 +125,7 @@ public:
 #endif // Q_OS_MAC
 
 #if defined(Q_OS_LINUX) && !defined(QESP_NO_UDEV)
-    QPointer<QSocketNotifier> notifier;
-    int notifierFd;
-    struct udev *udev;
-    struct udev_monitor *monitor;
-
-    void _q_deviceEvent();
+    bool hotplugSubscribed;
 #endif
 
 private:
@@ -41,8 +41,9 @@ void QextSerialEnumeratorPrivate::destroy_sys()
 {
 }
 
-QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys()
+QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys(QextSerialEnumerator::PortDetails details)
 {
+    Q_UNUSED(details);
     QList<QextPortInfo> infoList;
     QESP_WARNING("Enumeration for POSIX systems (except Linux) is not implemented yet.");
     return infoList;
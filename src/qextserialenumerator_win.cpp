@@ -50,13 +50,8 @@
   Internal window which is used to receive device arrvial and removal message.
 */
 
-#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
-#include <QtGui/QWidget>
-class QextSerialRegistrationWidget : public QWidget
-#else
 #include <QtGui/QWindow>
 class QextSerialRegistrationWidget : public QWindow
-#endif
 {
 public:
     QextSerialRegistrationWidget(QextSerialEnumeratorPrivate *qese) {
@@ -66,12 +61,8 @@ public:
 
 protected:
 
-#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
-    bool winEvent(MSG *message, long *result) {
-#else
     bool nativeEvent(const QByteArray & /*eventType*/, void *msg, long *result) {
         MSG *message = static_cast<MSG *>(msg);
-#endif
         if (message->message == WM_DEVICECHANGE) {
             QTimer::singleShot(100, this, &QextSerialRegistrationWidget::triggerRescan);
             *result = 1;
@@ -264,8 +255,9 @@ static bool lessThan(const QextPortInfo &s1, const QextPortInfo &s2)
 
     return list of ports currently available in the system.
 */
-QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys()
+QList<QextPortInfo> QextSerialEnumeratorPrivate::getPorts_sys(QextSerialEnumerator::PortDetails details)
 {
+    Q_UNUSED(details);
     QList<QextPortInfo> ports;
 
     // search all device classes
@@ -321,18 +313,18 @@ bool operator==(const QextPortInfo &a, const QextPortInfo &b)
 
 void QextSerialEnumeratorPrivate::rescanDevices()
 {
-    Q_Q(QextSerialEnumerator);
     QList<QextPortInfo> currentlyPresentDevices = getPorts_sys();
     foreach (QextPortInfo port, currentlyPresentDevices) {
         if (!m_knownDevices.contains(port)) {
           m_knownDevices << port;
-          Q_EMIT q->deviceDiscovered(port);
+          queueDeviceChange(port, true);
         }
     }
     foreach (QextPortInfo port, m_knownDevices) {
         if (!currentlyPresentDevices.contains(port)) {
           m_knownDevices.removeOne(port);
-          Q_EMIT q->deviceRemoved(port);
+          queueDeviceChange(port, false);
         }
     }
+    scheduleDeviceChanges();
 }
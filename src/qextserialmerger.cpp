@@ -0,0 +1,344 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#include "qextserialmerger.h"
+#include "qextserialmerger_p.h"
+#include "qextserialport.h"
+#include "qextserialtrace_p.h"
+#include <QtCore/QTimer>
+#include <QtCore/QtAlgorithms>
+#include <algorithm>
+
+QextSerialMergerPrivate::QextSerialMergerPrivate(QextSerialMerger *q)
+    :nextId(0), maxLatency(10), flushTimer(0), released(0), late(0), q_ptr(q)
+{
+}
+
+QextSerialMergerPrivate::~QextSerialMergerPrivate()
+{
+    qDeleteAll(inputs);
+}
+
+static bool laterHead(const QextSerialMergerPrivate::Input *a, const QextSerialMergerPrivate::Input *b)
+{
+    qint64 ta = a->pending.first().timestamp;
+    qint64 tb = b->pending.first().timestamp;
+    return ta > tb || (ta == tb && a->id > b->id);
+}
+
+/*
+    Reads every port, then releases what no port can still precede.
+
+    Each port stamps its data when it reads it from the driver, so whatever
+    a port delivers after the moment it was read here carries a later time:
+    up to that moment, its watermark, the port is complete. Records up to
+    the oldest watermark are therefore in their final order. A port read
+    from another thread could lag behind; records older than maxLatency are
+    released anyway so it cannot stall the others; the flush timer runs
+    while records are held back, to release them in time.
+*/
+void QextSerialMergerPrivate::_q_collect()
+{
+    Q_Q(QextSerialMerger);
+    int before = ready.size();
+    qint64 horizon = Q_INT64_C(0x7fffffffffffffff);
+    for (int i = 0; i < inputs.size(); ++i) {
+        Input *input = inputs.at(i);
+        QextSerialPort *port = input->port;
+        if (!port) {
+            // removed or destroyed, gone once its records are released
+            if (input->pending.isEmpty()) {
+                delete inputs.takeAt(i--);
+            }
+            continue;
+        }
+        input->watermark = QextTraceRecorder::now();
+        for (;;) {
+            MergedRecord record;
+            record.port = input->id;
+            record.data = port->readTimestamped(&record.timestamp);
+            if (record.data.isEmpty())
+                break;
+            if (record.timestamp < released) {
+                // too late to be put in order
+                ++late;
+                ready.append(record);
+            } else {
+                input->pending.append(record);
+            }
+        }
+        horizon = qMin(horizon, input->watermark);
+    }
+    merge(qMax(horizon, QextTraceRecorder::now() - qint64(maxLatency) * 1000000));
+    bool holding = false;
+    foreach (const Input *input, inputs) {
+        if (!input->pending.isEmpty()) {
+            holding = true;
+            break;
+        }
+    }
+    if (flushTimer) {
+        if (!holding)
+            flushTimer->stop();
+        else if (!flushTimer->isActive())
+            flushTimer->start(qMax(maxLatency / 2, 1));
+    }
+    if (ready.size() > before)
+        emit q->readyRead();
+}
+
+/*
+    k-way merge of the ports' pending records up to \a horizon, through a
+    min-heap of the ports ordered by their oldest record.
+*/
+void QextSerialMergerPrivate::merge(qint64 horizon)
+{
+    heap.resize(0);
+    foreach (Input *input, inputs) {
+        if (!input->pending.isEmpty())
+            heap.append(input);
+    }
+    std::make_heap(heap.begin(), heap.end(), laterHead);
+    while (!heap.isEmpty()) {
+        Input *input = heap.first();
+        if (input->pending.first().timestamp > horizon)
+            break;
+        std::pop_heap(heap.begin(), heap.end(), laterHead);
+        released = input->pending.first().timestamp;
+        ready.append(input->pending.takeFirst());
+        if (input->pending.isEmpty())
+            heap.removeLast();
+        else
+            std::push_heap(heap.begin(), heap.end(), laterHead);
+    }
+}
+
+/*!
+    \class QextSerialMerger
+
+    \brief The QextSerialMerger class merges what several serial ports
+    receive into one stream ordered by time.
+
+    Buses are often watched through several taps: one adapter per
+    direction, or one per device talking to a controller. The merger reads
+    the ports given to addPort() and turns their data into MergedRecord
+    entries, the bytes one port received at one time, delivered in the
+    order they were received across all ports.
+
+    The ports stamp their data as they read it from the driver (see
+    QextSerialPort::setReceiveTimestamps()). The merger reads all ports
+    whenever one of them has data, and every half maxLatency() while it
+    holds records back, and releases a record as soon as no port can still deliver an older one. For
+    ports that live in the merger's thread that is right away; a port that
+    is serviced by another thread holds records back for at most
+    maxLatency(). A record arriving later than that is released unordered
+    and counted by lateRecords().
+
+    \code
+    QextSerialMerger *merger = new QextSerialMerger(this);
+    int toDevice = merger->addPort(tapA);
+    merger->addPort(tapB);
+    connect(merger, SIGNAL(readyRead()), this, SLOT(onRecords()));
+
+    void MyClass::onRecords()
+    {
+        foreach (const MergedRecord &record, merger->readAllRecords())
+            decode(record.port == toDevice, record.timestamp, record.data);
+    }
+    \endcode
+
+    The merger consumes the data of its ports, so they should not be read
+    elsewhere while they are merged. Ports are not owned; one that is
+    destroyed simply leaves the merge.
+*/
+
+/*!
+    \fn void QextSerialMerger::readyRead()
+
+    This signal is emitted when new records are ready to be read.
+*/
+
+/*!
+    Constructs a merger with the given \a parent.
+*/
+QextSerialMerger::QextSerialMerger(QObject *parent)
+    :QObject(parent), d_ptr(new QextSerialMergerPrivate(this))
+{
+}
+
+/*!
+    Destroys the merger. Records not yet read are lost.
+*/
+QextSerialMerger::~QextSerialMerger()
+{
+    delete d_ptr;
+}
+
+/*!
+    Adds \a port to the merge, enables its receive timestamps, and returns
+    the id its records carry. Ids are not reused. Adding a port twice
+    returns its id.
+*/
+int QextSerialMerger::addPort(QextSerialPort *port)
+{
+    Q_D(QextSerialMerger);
+    foreach (const QextSerialMergerPrivate::Input *input, d->inputs) {
+        if (input->port == port)
+            return input->id;
+    }
+    QextSerialMergerPrivate::Input *input = new QextSerialMergerPrivate::Input;
+    input->id = d->nextId++;
+    input->port = port;
+    input->watermark = 0;
+    d->inputs.append(input);
+    port->setReceiveTimestamps(true);
+    connect(port, SIGNAL(readyRead()), this, SLOT(_q_collect()));
+    // started by _q_collect() while records are held back
+    if (!d->flushTimer) {
+        d->flushTimer = new QTimer(this);
+        d->flushTimer->setTimerType(Qt::PreciseTimer);
+        connect(d->flushTimer, SIGNAL(timeout()), this, SLOT(_q_collect()));
+    }
+    return input->id;
+}
+
+/*!
+    Takes \a port out of the merge. What was already read from it is still
+    delivered in order; its receive timestamps stay enabled.
+*/
+void QextSerialMerger::removePort(QextSerialPort *port)
+{
+    Q_D(QextSerialMerger);
+    d->_q_collect();
+    foreach (QextSerialMergerPrivate::Input *input, d->inputs) {
+        if (input->port == port) {
+            disconnect(port, 0, this, 0);
+            input->port = 0;
+        }
+    }
+}
+
+/*!
+    Returns the port with the given \a id, or 0 if it left the merge.
+*/
+QextSerialPort *QextSerialMerger::port(int id) const
+{
+    Q_D(const QextSerialMerger);
+    foreach (const QextSerialMergerPrivate::Input *input, d->inputs) {
+        if (input->id == id)
+            return input->port;
+    }
+    return 0;
+}
+
+/*!
+    Returns the ports being merged.
+*/
+QList<QextSerialPort *> QextSerialMerger::ports() const
+{
+    Q_D(const QextSerialMerger);
+    QList<QextSerialPort *> list;
+    foreach (const QextSerialMergerPrivate::Input *input, d->inputs) {
+        if (input->port)
+            list.append(input->port);
+    }
+    return list;
+}
+
+/*!
+    Sets the longest time in milliseconds a record is held back waiting for
+    older data of other ports to \a msecs; 10 by default.
+*/
+void QextSerialMerger::setMaxLatency(int msecs)
+{
+    Q_D(QextSerialMerger);
+    d->maxLatency = qMax(msecs, 1);
+    if (d->flushTimer && d->flushTimer->isActive())
+        d->flushTimer->start(qMax(d->maxLatency / 2, 1));
+}
+
+/*!
+    Returns the latency bound set by setMaxLatency().
+*/
+int QextSerialMerger::maxLatency() const
+{
+    Q_D(const QextSerialMerger);
+    return d->maxLatency;
+}
+
+/*!
+    Returns the number of records ready to be read.
+*/
+int QextSerialMerger::recordsAvailable() const
+{
+    Q_D(const QextSerialMerger);
+    return d->ready.size();
+}
+
+/*!
+    Takes the oldest ready record. If none is ready, the returned record has
+    a port of -1.
+*/
+MergedRecord QextSerialMerger::readRecord()
+{
+    Q_D(QextSerialMerger);
+    if (!d->ready.isEmpty())
+        return d->ready.takeFirst();
+    MergedRecord record = MergedRecord();
+    record.port = -1;
+    record.timestamp = -1;
+    return record;
+}
+
+/*!
+    Takes all ready records, oldest first.
+*/
+QList<MergedRecord> QextSerialMerger::readAllRecords()
+{
+    Q_D(QextSerialMerger);
+    QList<MergedRecord> records;
+    records.swap(d->ready);
+    return records;
+}
+
+/*!
+    Returns the number of records that arrived after newer records of other
+    ports had been released, and so were delivered out of order. It stays 0
+    unless a port is starved for longer than maxLatency().
+*/
+quint64 QextSerialMerger::lateRecords() const
+{
+    Q_D(const QextSerialMerger);
+    return d->late;
+}
+
+#include "moc_qextserialmerger.cpp"
@@ -0,0 +1,84 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#ifndef _QEXTSERIALMERGER_H_
+#define _QEXTSERIALMERGER_H_
+
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include "qextserialport_global.h"
+
+/**
+ * bytes one port received at one time, see QextSerialMerger
+ */
+struct MergedRecord
+{
+    int port;
+    qint64 timestamp;   // ns, see QextSerialPort::setReceiveTimestamps()
+    QByteArray data;
+};
+
+class QextSerialPort;
+class QextSerialMergerPrivate;
+class QEXTSERIALPORT_EXPORT QextSerialMerger : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QextSerialMerger)
+public:
+    explicit QextSerialMerger(QObject *parent=0);
+    ~QextSerialMerger();
+
+    int addPort(QextSerialPort *port);
+    void removePort(QextSerialPort *port);
+    QextSerialPort *port(int id) const;
+    QList<QextSerialPort *> ports() const;
+
+    void setMaxLatency(int msecs);
+    int maxLatency() const;
+
+    int recordsAvailable() const;
+    MergedRecord readRecord();
+    QList<MergedRecord> readAllRecords();
+    quint64 lateRecords() const;
+
+Q_SIGNALS:
+    void readyRead();
+
+private:
+    Q_DISABLE_COPY(QextSerialMerger)
+    Q_PRIVATE_SLOT(d_func(), void _q_collect())
+
+    QextSerialMergerPrivate *d_ptr;
+};
+
+#endif /*_QEXTSERIALMERGER_H_*/
@@ -0,0 +1,86 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#ifndef _QEXTSERIALMERGER_P_H_
+#define _QEXTSERIALMERGER_P_H_
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QESP API.  It exists for the convenience
+// of other QESP classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qextserialmerger.h"
+#include <QtCore/QPointer>
+#include <QtCore/QVector>
+
+class QTimer;
+
+class QextSerialMergerPrivate
+{
+    Q_DECLARE_PUBLIC(QextSerialMerger)
+public:
+    QextSerialMergerPrivate(QextSerialMerger *q);
+    ~QextSerialMergerPrivate();
+
+    // one merged port: records read from it but not yet released, oldest
+    // first, and the time up to which it has been read completely
+    struct Input
+    {
+        int id;
+        QPointer<QextSerialPort> port;
+        QList<MergedRecord> pending;
+        qint64 watermark;
+    };
+
+    void merge(qint64 horizon);
+    void _q_collect();
+
+    QList<Input *> inputs;
+    QVector<Input *> heap;
+    QList<MergedRecord> ready;
+    int nextId;
+    int maxLatency;
+    QTimer *flushTimer;
+    qint64 released;
+    quint64 late;
+
+private:
+    QextSerialMerger *q_ptr;
+};
+
+#endif //_QEXTSERIALMERGER_P_H_
@@ -0,0 +1,403 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#include "qextserialmetrics.h"
+#include "qextserialmetrics_p.h"
+#include "qextserialport_p.h"
+#include "qextserialenumerator_p.h"
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QSocketNotifier>
+#include <QtCore/QTimer>
+#ifdef Q_OS_UNIX
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <string.h>
+#  include <unistd.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#endif
+
+#ifdef MSG_NOSIGNAL
+#  define QESP_SEND_FLAGS MSG_NOSIGNAL
+#else
+#  define QESP_SEND_FLAGS 0
+#endif
+
+QextSerialMetricsExporterPrivate::QextSerialMetricsExporterPrivate(QextSerialMetricsExporter *q)
+    :listenFd(-1), listenNotifier(0), dumpInterval(0), dumpTimer(0), q_ptr(q)
+{
+}
+
+QextSerialMetricsExporterPrivate::~QextSerialMetricsExporterPrivate()
+{
+    close_sys();
+}
+
+void QextSerialMetricsExporterPrivate::dropClient(Client *client)
+{
+    clients.removeOne(client);
+    // called from the notifiers' own activated() handlers
+    if (client->readNotifier) {
+        client->readNotifier->setEnabled(false);
+        client->readNotifier->deleteLater();
+    }
+    if (client->writeNotifier) {
+        client->writeNotifier->setEnabled(false);
+        client->writeNotifier->deleteLater();
+    }
+#ifdef Q_OS_UNIX
+    ::close(client->fd);
+#endif
+    delete client;
+}
+
+/*
+    Answers a scraper. \a http is set if it sent an HTTP request, raw
+    clients get the bare exposition.
+*/
+void QextSerialMetricsExporterPrivate::respond(Client *client, bool http)
+{
+    QByteArray body = QextSerialMetricsExporter::collect();
+    if (http) {
+        bool get = client->request.startsWith("GET ");
+        client->response = get ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 405 Method Not Allowed\r\n";
+        if (!get)
+            body.clear();
+        client->response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                            "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                            "Connection: close\r\n\r\n";
+        client->response += body;
+    } else {
+        client->response = body;
+    }
+    client->request.clear();
+    client->readNotifier->setEnabled(false);
+    writeResponse_sys(client);
+}
+
+/*
+    Writes the current exposition to the dump file. QSaveFile replaces it in
+    one step, so readers such as node_exporter's textfile collector never see
+    a partial file.
+*/
+void QextSerialMetricsExporterPrivate::dump()
+{
+    QSaveFile file(dumpFileName);
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(QextSerialMetricsExporter::collect()) < 0 || !file.commit())
+        QESP_WARNING("QextSerialMetricsExporter: cannot write %s", qPrintable(dumpFileName));
+}
+
+#ifdef Q_OS_UNIX
+bool QextSerialMetricsExporterPrivate::listen_sys(const QString &socketPath)
+{
+    Q_Q(QextSerialMetricsExporter);
+    QByteArray name = QFile::encodeName(socketPath);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (name.isEmpty() || name.size() >= int(sizeof(addr.sun_path))) {
+        QESP_WARNING("QextSerialMetricsExporter: invalid socket path %s", qPrintable(socketPath));
+        return false;
+    }
+    memcpy(addr.sun_path, name.constData(), name.size());
+
+    // a socket left behind by an earlier run would make bind() fail
+    struct stat st;
+    if (::lstat(name.constData(), &st) == 0 && S_ISSOCK(st.st_mode))
+        ::unlink(name.constData());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return false;
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (::bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || ::listen(fd, MaxClients) == -1) {
+        QESP_WARNING("QextSerialMetricsExporter: cannot listen on %s: %s", qPrintable(socketPath), strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    listenFd = fd;
+    path = socketPath;
+    listenNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, q);
+    q->connect(listenNotifier, &QSocketNotifier::activated, q, [this] { acceptClients_sys(); });
+    return true;
+}
+
+void QextSerialMetricsExporterPrivate::close_sys()
+{
+    while (!clients.isEmpty())
+        dropClient(clients.first());
+    if (listenFd == -1)
+        return;
+    delete listenNotifier;
+    listenNotifier = 0;
+    ::close(listenFd);
+    listenFd = -1;
+    ::unlink(QFile::encodeName(path).constData());
+    path.clear();
+}
+
+void QextSerialMetricsExporterPrivate::acceptClients_sys()
+{
+    Q_Q(QextSerialMetricsExporter);
+    int fd;
+    while ((fd = ::accept(listenFd, 0, 0)) != -1) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        // a client that never sends its request must not pile up
+        if (clients.size() == MaxClients)
+            dropClient(clients.first());
+        Client *client = new Client;
+        client->fd = fd;
+        client->written = 0;
+        client->writeNotifier = 0;
+        client->readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, q);
+        q->connect(client->readNotifier, &QSocketNotifier::activated, q, [this, client] {
+            readRequest_sys(client);
+        });
+        clients.append(client);
+    }
+}
+
+/*
+    Waits for the end of the HTTP request header. A client that shuts down
+    its side without sending anything gets the raw exposition instead.
+*/
+void QextSerialMetricsExporterPrivate::readRequest_sys(Client *client)
+{
+    char buffer[1024];
+    ssize_t n = ::read(client->fd, buffer, sizeof(buffer));
+    if (n > 0) {
+        client->request.append(buffer, int(n));
+        if (client->request.contains("\r\n\r\n") || client->request.contains("\n\n"))
+            respond(client, true);
+        else if (client->request.size() > MaxRequestSize)
+            dropClient(client);
+    } else if (n == 0) {
+        respond(client, !client->request.isEmpty());
+    } else if (errno != EAGAIN && errno != EINTR) {
+        dropClient(client);
+    }
+}
+
+void QextSerialMetricsExporterPrivate::writeResponse_sys(Client *client)
+{
+    Q_Q(QextSerialMetricsExporter);
+    while (client->written < client->response.size()) {
+        ssize_t n = ::send(client->fd, client->response.constData() + client->written,
+                           client->response.size() - client->written, QESP_SEND_FLAGS);
+        if (n >= 0) {
+            client->written += int(n);
+        } else if (errno == EAGAIN) {
+            if (!client->writeNotifier) {
+                client->writeNotifier = new QSocketNotifier(client->fd, QSocketNotifier::Write, q);
+                q->connect(client->writeNotifier, &QSocketNotifier::activated, q, [this, client] {
+                    writeResponse_sys(client);
+                });
+            }
+            return;
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+    dropClient(client);
+}
+#else
+bool QextSerialMetricsExporterPrivate::listen_sys(const QString &socketPath)
+{
+    Q_UNUSED(socketPath);
+    QESP_WARNING("QextSerialMetricsExporter: local sockets are not supported on this platform");
+    return false;
+}
+
+void QextSerialMetricsExporterPrivate::close_sys()
+{
+}
+
+void QextSerialMetricsExporterPrivate::acceptClients_sys()
+{
+}
+
+void QextSerialMetricsExporterPrivate::readRequest_sys(Client *client)
+{
+    Q_UNUSED(client);
+}
+
+void QextSerialMetricsExporterPrivate::writeResponse_sys(Client *client)
+{
+    Q_UNUSED(client);
+}
+#endif // Q_OS_UNIX
+
+/*!
+    \class QextSerialMetricsExporter
+
+    \brief The QextSerialMetricsExporter class publishes statistics of all
+    serial ports in the process for a monitoring agent.
+
+    It reports the counters of every live QextSerialPort (see
+    QextSerialPort::statistics()), the latency percentiles of the ports that
+    have histograms enabled, and the hotplug activity of the
+    QextSerialEnumerator objects, in the Prometheus text exposition format.
+
+    The metrics can be served on a Unix domain socket with listen(). Clients
+    may send an HTTP GET, as \c{curl --unix-socket} and most agents do, or
+    just connect and shut down their sending side to get the bare text.
+    setDumpFile() instead rewrites a file periodically, e.g. for the textfile
+    collector of node_exporter. Both can be used at the same time.
+
+    Collecting reads the ports' atomic counters only. It takes no lock that
+    reads or writes on the ports ever take, so scraping hundreds of ports
+    does not disturb their traffic.
+
+    \code
+    QextSerialMetricsExporter *exporter = new QextSerialMetricsExporter(this);
+    exporter->listen("/run/myapp/serial-metrics.sock");
+    \endcode
+*/
+
+/*!
+    Constructs an exporter with the given \a parent. It does nothing until
+    listen() or setDumpFile() is called.
+*/
+QextSerialMetricsExporter::QextSerialMetricsExporter(QObject *parent)
+    :QObject(parent), d_ptr(new QextSerialMetricsExporterPrivate(this))
+{
+}
+
+/*!
+    Stops serving and removes the socket.
+*/
+QextSerialMetricsExporter::~QextSerialMetricsExporter()
+{
+    delete d_ptr;
+}
+
+/*!
+    Serves the metrics on the Unix domain socket \a socketPath, replacing
+    a stale socket file left at that path. Returns false on failure, and
+    always on platforms without local sockets.
+*/
+bool QextSerialMetricsExporter::listen(const QString &socketPath)
+{
+    Q_D(QextSerialMetricsExporter);
+    d->close_sys();
+    return d->listen_sys(socketPath);
+}
+
+/*!
+    Stops serving, drops the clients being answered and removes the socket.
+*/
+void QextSerialMetricsExporter::close()
+{
+    Q_D(QextSerialMetricsExporter);
+    d->close_sys();
+}
+
+/*!
+    Returns true while the metrics are served on a socket.
+*/
+bool QextSerialMetricsExporter::isListening() const
+{
+    Q_D(const QextSerialMetricsExporter);
+    return d->listenFd != -1;
+}
+
+/*!
+    Returns the path passed to listen(), or an empty string.
+*/
+QString QextSerialMetricsExporter::socketPath() const
+{
+    Q_D(const QextSerialMetricsExporter);
+    return d->path;
+}
+
+/*!
+    Writes the metrics to \a fileName every \a intervalMsecs milliseconds,
+    and right away. An empty \a fileName stops the dumps.
+*/
+void QextSerialMetricsExporter::setDumpFile(const QString &fileName, int intervalMsecs)
+{
+    Q_D(QextSerialMetricsExporter);
+    d->dumpFileName = fileName;
+    d->dumpInterval = qMax(intervalMsecs, 1);
+    if (fileName.isEmpty()) {
+        delete d->dumpTimer;
+        d->dumpTimer = 0;
+        return;
+    }
+    if (!d->dumpTimer) {
+        d->dumpTimer = new QTimer(this);
+        connect(d->dumpTimer, &QTimer::timeout, this, [d] { d->dump(); });
+    }
+    d->dumpTimer->start(d->dumpInterval);
+    d->dump();
+}
+
+/*!
+    Returns the file set by setDumpFile().
+*/
+QString QextSerialMetricsExporter::dumpFile() const
+{
+    Q_D(const QextSerialMetricsExporter);
+    return d->dumpFileName;
+}
+
+/*!
+    Returns the interval of the file dumps in milliseconds.
+*/
+int QextSerialMetricsExporter::dumpInterval() const
+{
+    Q_D(const QextSerialMetricsExporter);
+    return d->dumpInterval;
+}
+
+/*!
+    Returns the current metrics of all ports and enumerators in the process,
+    in the Prometheus text exposition format.
+*/
+QByteArray QextSerialMetricsExporter::collect()
+{
+    QByteArray out;
+    QextSerialPortPrivate::writeMetrics(&out);
+    QextSerialEnumeratorPrivate::writeMetrics(&out);
+    return out;
+}
+
+#include "moc_qextserialmetrics.cpp"
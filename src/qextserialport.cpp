@@ -31,10 +31,71 @@
 
 #include "qextserialport.h"
 #include "qextserialport_p.h"
+#include "qextserialtrace_p.h"
 #include <stdio.h>
 #include <QtCore/QDebug>
 #include <QtCore/QReadLocker>
 #include <QtCore/QWriteLocker>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QPointer>
+#include <QtCore/QTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QHash>
+
+QESP_DEFINE_PROBE(open)
+QESP_DEFINE_PROBE(close)
+QESP_DEFINE_PROBE(can_read)
+QESP_DEFINE_PROBE(read_data)
+QESP_DEFINE_PROBE(write)
+QESP_DEFINE_PROBE(settings)
+
+Q_GLOBAL_STATIC(QThreadPool, openPool)
+
+// Every live port, for QextSerialMetricsExporter. Taken when ports are
+// created, destroyed or renamed and by the exporter, never on I/O paths.
+struct QextPortRegistry
+{
+    QMutex mutex;
+    QList<QextSerialPortPrivate *> ports;
+};
+
+Q_GLOBAL_STATIC(QextPortRegistry, portRegistry)
+
+/*
+    Runs QextSerialPortPrivate::openDevice_sys() on a worker thread. The part of
+    open() that must happen in the port's own thread is left to the caller, or,
+    if \a notify is set, posted to the port when done.
+*/
+class QextSerialOpenTask : public QRunnable
+{
+public:
+    QextSerialOpenTask(QextSerialPortPrivate *d, bool notify)
+        : d(d), notify(notify), success(false) {
+    }
+
+    void run() {
+        {
+            QWriteLocker locker(&d->lock);
+            success = d->openDevice_sys();
+            d->pendingOpenResult = success;
+        }
+        if (notify) {
+            QextSerialPortPrivate *priv = d;
+            bool ok = success;
+            QMetaObject::invokeMethod(d->q_ptr, [priv, ok] { priv->_q_openFinished(ok); },
+                                      Qt::QueuedConnection);
+            // the destructor of the port waits for this
+            d->openDone.release();
+        }
+    }
+
+    QextSerialPortPrivate *d;
+    bool notify;
+    bool success;
+};
 
 /*!
     \class PortSettings
@@ -53,6 +114,47 @@
     \endcode
 */
 
+/*!
+    \class PortStatistics
+
+    \brief The PortStatistics class holds the counters of a port.
+
+    \code
+    quint64 bytesReceived;      // bytes read from the driver
+    quint64 bytesSent;          // bytes handed to the driver
+    quint64 readCalls;          // read system calls
+    quint64 writeCalls;         // write system calls
+    quint64 notifierWakeups;    // read notifications (or poll ticks) handled
+    quint64 readyReadEmitted;   // readyRead() signals
+    quint64 wouldBlock;         // reads and writes that failed with EAGAIN
+    quint64 shortWrites;        // writes that took less than offered
+    quint64 rxBufferHighWater;  // largest fill of the internal read buffer
+    quint64 rxBufferReallocs;   // reallocations of the internal read buffer
+    quint64 settingsApplied;    // tcsetattr() / SetCommConfig() calls
+    \endcode
+
+    \sa QextSerialPort::statistics()
+*/
+
+/*!
+    \class ReadTuning
+
+    \brief The ReadTuning class holds the state of the adaptive read controller.
+
+    \code
+    qint64 meanGapUsecs;        // average time between arrivals
+    int meanChunkBytes;         // average bytes per arrival
+    int notifyThreshold;        // bytes buffered before readyRead() is emitted
+    int readChunkSize;          // bytes asked for per read
+    int bufferReserve;          // growth step of the read buffer
+    qint64 wakeups;             // arrivals seen by the controller
+    qint64 coalescedWakeups;    // arrivals that did not emit readyRead()
+    qint64 latencyFlushes;      // readyRead() emitted because maxReadLatency passed
+    \endcode
+
+    \sa QextSerialPort::setAdaptiveReads()
+*/
+
 QextSerialPortPrivate::QextSerialPortPrivate(QextSerialPort *q)
     :lock(QReadWriteLock::Recursive), q_ptr(q)
 {
@@ -64,15 +166,185 @@ QextSerialPortPrivate::QextSerialPortPrivate(QextSerialPort *q)
     settings.StopBits = STOP_1;
     settings.Timeout_Millisec = 10;
     settingsDirtyFlags = DFE_ALL;
+    settingsTransaction = 0;
+    queryMode = QextSerialPort::EventDriven;
+    recordSize = 0;
+    openPending = false;
+    pendingOpenResult = false;
+    pendingOpenMode = QIODevice::NotOpen;
+    busyPollBudget = 0;
+    adaptivePolling = false;
+    batchedPolling = false;
+    pollStreak = 0;
+    adaptiveReads = false;
+    maxReadLatency = 2000;
+    latencyTimer = 0;
+    resetReadTuning();
+    histogramStorage = 0;
+    lockProfileStorage = 0;
+    captureStorage = 0;
+    rxStamp = -1;
+    rxTimestamps = false;
+    rxStampHead = 0;
+    rxStampedBytes = 0;
+    clock.start();
+    traceTrack = QextTraceRecorder::newTrack();
+    bound = false;
+    hotplug = 0;
+    reconnectTimer = 0;
+    reconnectMode = QIODevice::NotOpen;
+    reconnectAttempts = 0;
+    reconnectDelay = 0;
+    reconnectInitialDelay = 100;
+    reconnectMaxDelay = 5000;
 
     platformSpecificInit();
+
+    QextPortRegistry *registry = portRegistry();
+    QMutexLocker locker(&registry->mutex);
+    registry->ports.append(this);
 }
 
 QextSerialPortPrivate::~QextSerialPortPrivate()
 {
+    if (!portRegistry.isDestroyed()) {
+        QextPortRegistry *registry = portRegistry();
+        QMutexLocker locker(&registry->mutex);
+        registry->ports.removeOne(this);
+    }
     platformSpecificDestruct();
+    delete histogramStorage;
+    delete lockProfileStorage;
+    delete captureStorage;
+}
+
+quint64 QextLatencyHistogram::samples() const
+{
+    quint64 total = 0;
+    for (int i = 0; i < Buckets; ++i)
+        total += counts[i].load();
+    return total;
+}
+
+/*
+    Returns the smallest bucket value below which \a percentile percent of the
+    samples lie, -1 if nothing has been recorded.
+*/
+qint64 QextLatencyHistogram::percentile(double percentile) const
+{
+    quint64 snapshot[Buckets];
+    quint64 total = 0;
+    for (int i = 0; i < Buckets; ++i) {
+        snapshot[i] = counts[i].load();
+        total += snapshot[i];
+    }
+    if (!total)
+        return -1;
+
+    quint64 wanted = quint64(qBound(0.0, percentile, 100.0) / 100.0 * double(total) + 0.5);
+    wanted = qBound(quint64(1), wanted, total);
+    quint64 seen = 0;
+    for (int i = 0; i < Buckets; ++i) {
+        seen += snapshot[i];
+        if (seen >= wanted)
+            return bucketValue(i);
+    }
+    return bucketValue(Buckets - 1);
+}
+
+void QextLatencyHistogram::reset()
+{
+    for (int i = 0; i < Buckets; ++i)
+        counts[i].store(0);
 }
 
+/*
+    Records how long a lock was held by the scope it lives in.
+*/
+class QextLatencyScope
+{
+public:
+    QextLatencyScope(QextSerialPortPrivate *d, QextLatencyHistogram QextLatencyHistograms::*which)
+        : d(d), histograms(d->histograms.loadAcquire()), which(which),
+          start(histograms ? d->clock.nsecsElapsed() : 0) {
+    }
+    ~QextLatencyScope() {
+        if (histograms)
+            (histograms->*which).record(d->clock.nsecsElapsed() - start);
+    }
+
+private:
+    QextSerialPortPrivate *d;
+    QextLatencyHistograms *histograms;
+    QextLatencyHistogram QextLatencyHistograms::*which;
+    qint64 start;
+};
+
+/*
+    Takes the port's lock in place of QReadLocker/QWriteLocker at the call
+    sites reported by QextSerialPort::lockProfile(). While profiling is off
+    this costs one atomic load over the plain lockers.
+*/
+class QextProfiledLocker
+{
+public:
+    enum Mode { Read, Write };
+
+    QextProfiledLocker(const QextSerialPortPrivate *d, QextSerialPort::LockSite site, Mode mode = Write)
+        : lock(&d->lock), stats(0), clock(&d->clock), acquired(0) {
+        if (QextLockProfiles *profiles = d->lockProfiles.loadAcquire()) {
+            stats = &profiles->sites[site];
+            lockProfiled(mode);
+        } else if (mode == Read) {
+            lock->lockForRead();
+        } else {
+            lock->lockForWrite();
+        }
+    }
+    ~QextProfiledLocker() {
+        if (stats) {
+            quint64 held = quint64(clock->nsecsElapsed() - acquired);
+            stats->totalHold.fetchAndAddRelaxed(held);
+            raise(&stats->maxHold, held);
+            stats->hold.record(qint64(held));
+        }
+        lock->unlock();
+    }
+
+private:
+    void lockProfiled(Mode mode) {
+        qint64 start = clock->nsecsElapsed();
+        // a successful try means the lock was free: no wait to report
+        bool free = mode == Read ? lock->tryLockForRead() : lock->tryLockForWrite();
+        if (!free) {
+            if (mode == Read)
+                lock->lockForRead();
+            else
+                lock->lockForWrite();
+        }
+        acquired = clock->nsecsElapsed();
+        quint64 waited = free ? 0 : quint64(acquired - start);
+        stats->acquisitions.fetchAndAddRelaxed(1);
+        if (!free) {
+            stats->contended.fetchAndAddRelaxed(1);
+            stats->totalWait.fetchAndAddRelaxed(waited);
+            raise(&stats->maxWait, waited);
+        }
+        stats->wait.record(qint64(waited));
+    }
+
+    static void raise(QAtomicInteger<quint64> *max, quint64 value) {
+        quint64 current = max->load();
+        while (value > current && !max->testAndSetRelaxed(current, value))
+            current = max->load();
+    }
+
+    QReadWriteLock *lock;
+    QextLockSiteStats *stats;
+    const QElapsedTimer *clock;
+    qint64 acquired;
+};
+
 void QextSerialPortPrivate::setBaudRate(BaudRateType baudRate, bool update)
 {
     switch (baudRate) {
@@ -122,7 +394,7 @@ void QextSerialPortPrivate::setBaudRate(BaudRateType baudRate, bool update)
     case BAUD38400:
     case BAUD57600:
     case BAUD115200:
-#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
+#if defined(Q_OS_WIN) || defined(Q_OS_MAC) || defined(QESP_HAVE_TERMIOS2)
     default:
 #endif
         settings.BaudRate = baudRate;
@@ -130,7 +402,7 @@ void QextSerialPortPrivate::setBaudRate(BaudRateType baudRate, bool update)
         if (update && q_func()->isOpen())
             updatePortSettings();
         break;
-#if !(defined(Q_OS_WIN) || defined(Q_OS_MAC))
+#if !(defined(Q_OS_WIN) || defined(Q_OS_MAC) || defined(QESP_HAVE_TERMIOS2))
     default:
         QESP_WARNING()<<"QextSerialPort does not support baudRate:"<<baudRate;
 #endif
@@ -298,16 +570,514 @@ void QextSerialPortPrivate::setPortSettings(const PortSettings &settings, bool u
 }
 
 
+void QextSerialPortPrivate::updatePortSettings(QextSerialPort::ApplyMode when)
+{
+    if (!q_func()->isOpen() || !settingsDirtyFlags || settingsTransaction)
+        return;
+    QESP_PROBE_TIMER(probeStart, settings);
+    qint64 start = traceStart();
+    updatePortSettings_sys(when);
+    traceSlice("settings", start);
+    QESP_PROBE2(settings, port.toLocal8Bit().constData(), QESP_PROBE_ELAPSED(probeStart));
+}
+
+void QextSerialPortPrivate::_q_openFinished(bool success)
+{
+    Q_Q(QextSerialPort);
+    openDone.acquire();
+    {
+        QWriteLocker locker(&lock);
+        openPending = false;
+        if (success)
+            finishOpen_sys(pendingOpenMode);
+    }
+    Q_EMIT q->opened(success);
+}
+
+/*
+    A device has appeared. If it is the one the port is bound to, follow it to
+    its new name and, when the port lost its device while open, reopen it.
+*/
+void QextSerialPortPrivate::_q_deviceDiscovered(const QextPortInfo &info)
+{
+    Q_Q(QextSerialPort);
+    QextPortFilter identity;
+    {
+        QReadLocker locker(&lock);
+        if (!bound)
+            return;
+        identity = boundIdentity;
+    }
+    if (q->isOpen())
+        return;
+    bool matches = false;
+    foreach (const QextPortInfo &candidate, QextSerialEnumerator::findPorts(identity)) {
+        if (candidate.portName == info.portName) {
+            matches = true;
+            break;
+        }
+    }
+    if (matches)
+        followDevice(info);
+}
+
+/*
+    Renames the port to the bound device \a info, which is known to match the
+    identity, and reopens it if it lost its device while open.
+*/
+void QextSerialPortPrivate::followDevice(const QextPortInfo &info)
+{
+    Q_Q(QextSerialPort);
+    q->setPortName(info.portName);
+    QWriteLocker locker(&lock);
+    if (reconnectMode != QIODevice::NotOpen) {
+        reconnectDelay = reconnectInitialDelay;
+        locker.unlock();
+        _q_reconnect();
+    }
+}
+
+void QextSerialPortPrivate::_q_deviceRemoved(const QextPortInfo &info)
+{
+    Q_Q(QextSerialPort);
+    {
+        QReadLocker locker(&lock);
+        if (!bound)
+            return;
+        if (info.portName != port && info.physName != port
+                && !info.physName.endsWith(QLatin1Char('/') + port))
+            return;
+    }
+
+    if (q->isOpen()) {
+        QIODevice::OpenMode mode = q->openMode();
+        q->close();
+        QWriteLocker locker(&lock);
+        // unbound meanwhile, stay closed
+        if (!bound)
+            return;
+        reconnectMode = mode;
+        reconnectAttempts = 0;
+        downSince.start();
+        locker.unlock();
+        Q_EMIT q->disconnected();
+    } else if (reconnectTimer) {
+        // gone again before a retry succeeded, wait for the next arrival
+        reconnectTimer->stop();
+    }
+}
+
+/*
+    Tries to reopen the port on its bound device. Failures (the device node may
+    not be accessible yet right after it appeared) are retried with an
+    exponentially growing delay.
+*/
+void QextSerialPortPrivate::_q_reconnect()
+{
+    Q_Q(QextSerialPort);
+    QIODevice::OpenMode mode;
+    {
+        QReadLocker locker(&lock);
+        mode = reconnectMode;
+    }
+    if (mode == QIODevice::NotOpen || q->isOpen())
+        return;
+
+    ++reconnectAttempts;
+    if (q->open(mode)) {
+        {
+            QWriteLocker locker(&lock);
+            reconnectMode = QIODevice::NotOpen;
+        }
+        Q_EMIT q->reconnected(downSince.elapsed(), reconnectAttempts);
+        return;
+    }
+    QWriteLocker locker(&lock);
+    // unbindDevice() may have cleared it meanwhile
+    if (reconnectMode == QIODevice::NotOpen)
+        return;
+
+    if (!reconnectTimer) {
+        reconnectTimer = new QTimer(q);
+        reconnectTimer->setSingleShot(true);
+        q->connect(reconnectTimer, &QTimer::timeout, q, [this]{_q_reconnect();});
+    }
+    reconnectTimer->start(reconnectDelay);
+    reconnectDelay = qMin(reconnectDelay * 2, reconnectMaxDelay);
+}
+
+/*
+    Moves everything the driver has queued into readBuffer, but asks for at
+    least \a minSize bytes (which may block in Polling mode).
+    Returns the number of bytes appended.
+*/
+qint64 QextSerialPortPrivate::fillReadBuffer(qint64 minSize)
+{
+    qint64 maxSize = qMax(bytesAvailable_sys(), minSize);
+    if (maxSize <= 0)
+        return 0;
+    // also take what arrives between the query and the read
+    if (adaptiveReads && queryMode == QextSerialPort::EventDriven)
+        maxSize = qMax(maxSize, qint64(tuning.readChunkSize));
+#ifndef QESP_NO_STATISTICS
+    size_t capacity = readBuffer.bufferCapacity();
+#endif
+    char *writePtr = readBuffer.reserve(size_t(maxSize));
+    qint64 bytesRead = qMax(readData_sys(writePtr, maxSize), qint64(0));
+    captureData(QextCapture::Rx, writePtr, bytesRead);
+    if (bytesRead < maxSize)
+        readBuffer.chop(maxSize - bytesRead);
+    if (rxTimestamps && bytesRead > 0) {
+        RxStamp stamp = { bytesRead, QextTraceRecorder::now() };
+        rxStamps.append(stamp);
+        rxStampedBytes += bytesRead;
+    }
+#ifndef QESP_NO_STATISTICS
+    if (readBuffer.bufferCapacity() != capacity)
+        QESP_COUNT(rxBufferReallocs, 1);
+    // only the port's thread fills the buffer, no need for a CAS loop
+    if (quint64(readBuffer.size()) > counters.rxBufferHighWater.load())
+        counters.rxBufferHighWater.store(quint64(readBuffer.size()));
+#endif
+    return bytesRead;
+}
+
+/*
+    Takes the oldest bytes of readBuffer that arrived in one driver read,
+    with their receive time. Bytes that read() consumed in the meantime are
+    gone from the front of readBuffer and are dropped from the stamps first.
+*/
+QByteArray QextSerialPortPrivate::takeStamped(qint64 *timestamp)
+{
+    dropConsumedStamps();
+    qint64 buffered = readBuffer.size();
+    qint64 size = 0;
+    if (buffered > rxStampedBytes) {
+        // buffered before timestamps were enabled
+        size = buffered - rxStampedBytes;
+        *timestamp = rxStampHead < rxStamps.size() ? rxStamps.at(rxStampHead).timestamp
+                                                   : QextTraceRecorder::now();
+    } else if (rxStampHead < rxStamps.size()) {
+        const RxStamp &front = rxStamps.at(rxStampHead++);
+        size = front.size;
+        *timestamp = front.timestamp;
+        rxStampedBytes -= size;
+    } else {
+        *timestamp = -1;
+        return QByteArray();
+    }
+    QByteArray data(int(size), Qt::Uninitialized);
+    readBuffer.read(data.data(), int(size));
+    dropConsumedStamps();
+    return data;
+}
+
+/*
+    Drops the stamps of bytes that already left the front of readBuffer,
+    so that reading a stamped port with read() or readAll() does not let
+    rxStamps grow.
+*/
+void QextSerialPortPrivate::dropConsumedStamps()
+{
+    qint64 buffered = readBuffer.size();
+    while (rxStampedBytes > buffered) {
+        RxStamp &front = rxStamps[rxStampHead];
+        qint64 gone = qMin(front.size, rxStampedBytes - buffered);
+        front.size -= gone;
+        rxStampedBytes -= gone;
+        if (!front.size)
+            ++rxStampHead;
+    }
+    if (rxStampHead == rxStamps.size()) {
+        rxStamps.resize(0);     // keeps the capacity
+        rxStampHead = 0;
+    } else if (rxStampHead > 64 && rxStampHead * 2 > rxStamps.size()) {
+        rxStamps.remove(0, rxStampHead);
+        rxStampHead = 0;
+    }
+}
+
+/*
+    Spins on non-blocking reads for at most busyPollBudget microseconds,
+    returns as soon as some bytes arrived (or 0 when the budget ran out).
+*/
+qint64 QextSerialPortPrivate::busyPoll()
+{
+    const qint64 budget = qint64(busyPollBudget) * 1000;
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        qint64 bytesRead = fillReadBuffer();
+        if (bytesRead > 0)
+            return bytesRead;
+    } while (timer.nsecsElapsed() < budget);
+    return 0;
+}
+
+void QextSerialPortPrivate::resetReadTuning()
+{
+    tuning.meanGapUsecs = 0;
+    tuning.meanChunkBytes = 0;
+    tuning.notifyThreshold = 1;
+    tuning.readChunkSize = 256;
+    tuning.bufferReserve = 4096;
+    tuning.wakeups = 0;
+    tuning.coalescedWakeups = 0;
+    tuning.latencyFlushes = 0;
+    for (int i = 0; i < ChunkBuckets; ++i)
+        chunkHistogram[i] = 0;
+    lastArrival.invalidate();
+}
+
+/*
+    Feeds one wakeup that delivered \a bytesRead bytes into the controller.
+
+    Gaps between arrivals and chunk sizes are tracked as exponentially weighted
+    moving averages (weight 1/8); chunk sizes additionally in a decaying log2
+    histogram. From that:
+    - readyRead is held back until about as many bytes are buffered as arrive
+      within maxReadLatency, so a steady stream is delivered in batches while
+      sparse request/response traffic is announced byte by byte;
+    - a read asks for twice the 90th percentile chunk, so bytes arriving just
+      after the FIONREAD query are picked up by the same syscall;
+    - the read buffer grows in steps big enough for a full batch.
+*/
+void QextSerialPortPrivate::updateReadTuning(qint64 bytesRead)
+{
+    ++tuning.wakeups;
+    qint64 gapUsecs = lastArrival.isValid() ? lastArrival.nsecsElapsed() / 1000 : maxReadLatency;
+    lastArrival.start();
+    if (tuning.meanGapUsecs == 0)
+        tuning.meanGapUsecs = qMax(gapUsecs, qint64(1));
+    else
+        tuning.meanGapUsecs += (gapUsecs - tuning.meanGapUsecs) / 8;
+    tuning.meanGapUsecs = qMax(tuning.meanGapUsecs, qint64(1));
+    tuning.meanChunkBytes += int((bytesRead - tuning.meanChunkBytes) / 8);
+    tuning.meanChunkBytes = qMax(tuning.meanChunkBytes, 1);
+
+    int bucket = 0;
+    while (bucket < ChunkBuckets - 1 && (qint64(1) << bucket) < bytesRead)
+        ++bucket;
+    quint32 total = 0;
+    for (int i = 0; i < ChunkBuckets; ++i) {
+        chunkHistogram[i] -= chunkHistogram[i] >> 4;
+        total += chunkHistogram[i];
+    }
+    chunkHistogram[bucket] += 1 << 12;
+    total += 1 << 12;
+
+    int p90 = 0;
+    for (quint32 sum = 0; p90 < ChunkBuckets - 1; ++p90) {
+        sum += chunkHistogram[p90];
+        if (sum >= total - total / 10)
+            break;
+    }
+
+    if (tuning.meanGapUsecs >= maxReadLatency) {
+        tuning.notifyThreshold = 1;
+    } else {
+        qint64 expected = qint64(tuning.meanChunkBytes) * maxReadLatency / tuning.meanGapUsecs;
+        tuning.notifyThreshold = int(qBound(qint64(1), expected, qint64(65536)));
+    }
+    tuning.readChunkSize = qBound(256, 2 << p90, 65536);
+    int reserve = 4096;
+    while (reserve < tuning.notifyThreshold + tuning.readChunkSize && reserve < (1 << 20))
+        reserve *= 2;
+    if (reserve != tuning.bufferReserve) {
+        tuning.bufferReserve = reserve;
+        readBuffer.setGrowth(size_t(reserve));
+    }
+}
+
+/*
+    Remembers when the oldest buffered bytes arrived, for the delivery
+    histogram; \a bytesRead were just appended to readBuffer.
+*/
+void QextSerialPortPrivate::stampArrival(qint64 bytesRead)
+{
+    if (bytesRead > 0 && (rxStamp < 0 || readBuffer.size() == bytesRead) && histograms.loadAcquire())
+        rxStamp = clock.nsecsElapsed();
+}
+
+void QextSerialPortPrivate::emitReadyRead()
+{
+    Q_Q(QextSerialPort);
+    if (latencyTimer)
+        latencyTimer->stop();
+    QESP_COUNT(readyReadEmitted, 1);
+    qint64 start = traceStart();
+    qint64 buffered = readBuffer.size();
+    Q_EMIT q->readyRead();
+    traceSlice("readyRead", start, buffered);
+}
+
+/*
+    Trace helpers. \a start comes from traceStart() and is 0 if recording
+    was off when the slice began; such slices are dropped.
+*/
+void QextSerialPortPrivate::traceSlice(const char *name, qint64 start, qint64 value)
+{
+    if (!start || !QextTraceRecorder::isActive())
+        return;
+    nameTraceTrack();
+    QextTraceRecorder::slice(traceTrack, name, start, value);
+}
+
+void QextSerialPortPrivate::traceLockWait(qint64 start)
+{
+    // uncontended locks would only clutter the timeline
+    if (start && QextTraceRecorder::now() - start >= 1000)
+        traceSlice("lock wait", start);
+}
+
+void QextSerialPortPrivate::traceCounter(const char *name, qint64 value)
+{
+    if (!QextTraceRecorder::isActive())
+        return;
+    nameTraceTrack();
+    QextTraceRecorder::counter(traceTrack, name, value);
+}
+
+void QextSerialPortPrivate::nameTraceTrack()
+{
+    int generation = QextTraceRecorder::generation();
+    int named = traceGeneration.load();
+    if (named != generation && traceGeneration.testAndSetRelaxed(named, generation))
+        QextTraceRecorder::nameTrack(traceTrack, port);
+}
+
+static void appendMetricHeader(QByteArray *out, const char *name, const char *type, const char *help)
+{
+    *out += QByteArray("# HELP ") + name + ' ' + help + "\n# TYPE " + name + ' ' + type + '\n';
+}
+
+#ifndef QESP_NO_STATISTICS
+static const struct {
+    const char *name;
+    const char *type;
+    const char *help;
+    QAtomicInteger<quint64> QextPortCounters::*counter;
+} portMetrics[] = {
+    { "qextserialport_bytes_received_total", "counter", "Bytes read from the device.", &QextPortCounters::bytesReceived },
+    { "qextserialport_bytes_sent_total", "counter", "Bytes written to the device.", &QextPortCounters::bytesSent },
+    { "qextserialport_read_calls_total", "counter", "Read system calls.", &QextPortCounters::readCalls },
+    { "qextserialport_write_calls_total", "counter", "Write system calls.", &QextPortCounters::writeCalls },
+    { "qextserialport_notifier_wakeups_total", "counter", "Read notifier activations.", &QextPortCounters::notifierWakeups },
+    { "qextserialport_ready_read_total", "counter", "readyRead() signals emitted.", &QextPortCounters::readyReadEmitted },
+    { "qextserialport_would_block_total", "counter", "Reads and writes that returned EAGAIN.", &QextPortCounters::wouldBlock },
+    { "qextserialport_short_writes_total", "counter", "Writes that took only part of the data.", &QextPortCounters::shortWrites },
+    { "qextserialport_rx_buffer_high_water_bytes", "gauge", "Largest size of the read buffer.", &QextPortCounters::rxBufferHighWater },
+    { "qextserialport_rx_buffer_reallocs_total", "counter", "Read buffer reallocations.", &QextPortCounters::rxBufferReallocs },
+    { "qextserialport_settings_applied_total", "counter", "Port settings applied to the device.", &QextPortCounters::settingsApplied }
+};
+#endif
+
+/*
+    Appends the metrics of every live port to \a out in the Prometheus text
+    format. Only the ports' atomic counters and histograms are read, under the
+    registry's mutex; the I/O paths are not disturbed.
+*/
+void QextSerialPortPrivate::writeMetrics(QByteArray *out)
+{
+    QextPortRegistry *registry = portRegistry();
+    QMutexLocker locker(&registry->mutex);
+
+    // label sets; ports sharing a name are told apart by an index
+    QList<QByteArray> labels;
+    QHash<QString, int> seen;
+    foreach (QextSerialPortPrivate *d, registry->ports) {
+        QByteArray label = "port=\"";
+        QByteArray name = d->metricsName.toUtf8();
+        for (int i = 0; i < name.size(); ++i) {
+            // the text format escapes backslash, quote and line feed
+            if (name.at(i) == '\\' || name.at(i) == '"' || name.at(i) == '\n')
+                label += '\\';
+            label += name.at(i) == '\n' ? 'n' : name.at(i);
+        }
+        label += '"';
+        int index = seen.value(d->metricsName);
+        if (index)
+            label += ",index=\"" + QByteArray::number(index) + '"';
+        seen.insert(d->metricsName, index + 1);
+        labels.append(label);
+    }
+
+    appendMetricHeader(out, "qextserialport_ports", "gauge", "Live QextSerialPort objects.");
+    *out += "qextserialport_ports " + QByteArray::number(registry->ports.size()) + '\n';
+
+#ifndef QESP_NO_STATISTICS
+    for (size_t m = 0; m < sizeof(portMetrics) / sizeof(portMetrics[0]); ++m) {
+        appendMetricHeader(out, portMetrics[m].name, portMetrics[m].type, portMetrics[m].help);
+        for (int i = 0; i < registry->ports.size(); ++i) {
+            quint64 value = (registry->ports.at(i)->counters.*portMetrics[m].counter).load();
+            *out += portMetrics[m].name;
+            *out += '{' + labels.at(i) + "} " + QByteArray::number(value) + '\n';
+        }
+    }
+#endif
+
+    static const char *const metricNames[] = { "delivery", "read_lock_hold", "write_dwell" };
+    static const double quantiles[] = { 0.5, 0.9, 0.99 };
+    appendMetricHeader(out, "qextserialport_latency_seconds", "summary",
+                       "Latencies of ports with histograms enabled, see QextSerialPort::LatencyMetric.");
+    for (int i = 0; i < registry->ports.size(); ++i) {
+        const QextLatencyHistograms *h = registry->ports.at(i)->histograms.loadAcquire();
+        if (!h)
+            continue;
+        const QextLatencyHistogram *metrics[] = { &h->delivery, &h->readLockHold, &h->writeDwell };
+        for (int m = 0; m < 3; ++m) {
+            QByteArray series = "qextserialport_latency_seconds";
+            QByteArray seriesLabels = labels.at(i) + ",metric=\"" + metricNames[m] + '"';
+            for (int q = 0; q < 3; ++q) {
+                qint64 nsecs = metrics[m]->percentile(quantiles[q] * 100);
+                *out += series + '{' + seriesLabels + ",quantile=\"" + QByteArray::number(quantiles[q])
+                        + "\"} " + (nsecs < 0 ? QByteArray("NaN") : QByteArray::number(nsecs / 1e9, 'g', 6)) + '\n';
+            }
+            *out += series + "_count{" + seriesLabels + "} " + QByteArray::number(metrics[m]->samples()) + '\n';
+        }
+    }
+}
+
 void QextSerialPortPrivate::_q_canRead()
 {
-    qint64 maxSize = bytesAvailable_sys();
-    if (maxSize > 0) {
-        char *writePtr = readBuffer.reserve(size_t(maxSize));
-        qint64 bytesRead = readData_sys(writePtr, maxSize);
-        if (bytesRead < maxSize)
-            readBuffer.chop(maxSize - bytesRead);
-        Q_Q(QextSerialPort);
-        Q_EMIT q->readyRead();
+    Q_Q(QextSerialPort);
+    QESP_COUNT(notifierWakeups, 1);
+    QESP_PROBE_TIMER(probeStart, can_read);
+    qint64 bytesRead = fillReadBuffer();
+    QESP_PROBE3(can_read, port.toLocal8Bit().constData(), bytesRead, QESP_PROBE_ELAPSED(probeStart));
+    if (bytesRead > 0)
+        traceCounter("rx buffered", readBuffer.size());
+    if (adaptivePolling)
+        updatePollMode_sys(bytesRead);
+    if (adaptiveReads && bytesRead > 0)
+        updateReadTuning(bytesRead);
+    while (bytesRead > 0) {
+        stampArrival(bytesRead);
+        // in record mode only announce whole records
+        int threshold = qMax(recordSize, adaptiveReads ? tuning.notifyThreshold : 0);
+        if (readBuffer.size() >= threshold) {
+            emitReadyRead();
+        } else if (adaptiveReads) {
+            // coalesce, but never hold data back longer than maxReadLatency
+            ++tuning.coalescedWakeups;
+            if (!latencyTimer) {
+                latencyTimer = new QTimer(q);
+                latencyTimer->setSingleShot(true);
+                latencyTimer->setTimerType(Qt::PreciseTimer);
+                q->connect(latencyTimer, &QTimer::timeout, q, [this] {
+                    if (canAnnounce()) {
+                        ++tuning.latencyFlushes;
+                        emitReadyRead();
+                    }
+                });
+            }
+            if (!latencyTimer->isActive())
+                latencyTimer->start(qMax(maxReadLatency / 1000, 1));
+        }
+        // keep the link hot: catch the next chunk without a trip through the event loop
+        if (busyPollBudget <= 0 || !q->isOpen())
+            break;
+        bytesRead = busyPoll();
     }
 }
 
@@ -347,10 +1117,79 @@ void QextSerialPortPrivate::_q_canRead()
     This behavior can be turned off by defining macro QESP_NO_WARN (to turn off all warnings)
     or QESP_NO_PORTABILITY_WARN (to turn off portability warnings) in the project.
 
+    \section1 Tracing
+    On Linux, building with \c{CONFIG += qesp_sdt} (requires \c{<sys/sdt.h>}
+    from systemtap-sdt-dev) adds static probes under the provider
+    \c qextserialport. They cost a single branch while no tracer is attached.
+    For a timeline that needs no external tools, see startTraceRecording().
+
+    \table
+    \header \o Probe \o Arguments
+    \row \o open \o port name, 1 on success, duration in ns
+    \row \o close \o port name
+    \row \o can_read \o port name, bytes buffered, duration in ns
+    \row \o read_data \o port name, bytes requested, bytes returned, duration in ns
+    \row \o write \o port name, bytes requested, bytes written, duration in ns
+    \row \o settings \o port name, duration in ns
+    \row \o hotplug \o udev action, device node (\c qesp_linux_udev builds only)
+    \endtable
+
+    \code
+    bpftrace -e 'usdt:./libQt5ExtSerialPort.so:qextserialport:write { @[str(arg0)] = hist(arg3); }'
+    \endcode
 
     \bold Author: Stefan Sander, Michal Policht, Brandon Fosdick, Liam Staskawicz, Debao Zhang
 */
 
+/*!
+  \enum QextSerialPort::ApplyMode
+
+  This enum type specifies when new settings take effect on an open port.
+  The setters always use ApplyNow; the others are chosen with applySettings()
+  or commitSettings():
+
+  \value ApplyNow
+     immediately (TCSANOW); bytes in flight may be sent or received with the new settings
+  \value ApplyDrain
+     after all pending output has been transmitted (TCSADRAIN); received input is kept
+  \value ApplyFlush
+     after all pending output has been transmitted, discarding received input (TCSAFLUSH)
+*/
+
+/*!
+  \enum QextSerialPort::LatencyMetric
+
+  This enum type specifies the latencies recorded by setLatencyHistograms():
+
+  \value DeliveryLatency
+     from the wakeup that brought bytes into the read buffer until the
+     application reads them, typically from its readyRead() handler
+  \value ReadLockHold
+     how long readData() holds the port's lock
+  \value WriteDwell
+     from the call to write() until the written bytes are expected on the
+     wire: waiting for the lock, the system call, and the time the driver's
+     output queue needs to drain at the current baud rate
+*/
+
+/*!
+  \enum QextSerialPort::LockSite
+
+  This enum type specifies the call sites profiled by setLockProfiling():
+
+  \value ReadDataLock
+     read() and the other QIODevice reading functions
+  \value WriteDataLock
+     write()
+  \value BytesAvailableLock
+     bytesAvailable(), also called by readAll()
+  \value LineStatusLock
+     lineStatus()
+  \value SettersLock
+     the port settings and modem line setters, applySettings(),
+     beginSettings() and commitSettings()
+*/
+
 /*!
   \enum QextSerialPort::QueryMode
 
@@ -371,6 +1210,25 @@ void QextSerialPortPrivate::_q_canRead()
  */
 
 
+/*!
+    \fn void QextSerialPort::opened(bool success)
+    This signal is emitted when an openAsync() request has completed.
+    \a success is true if the port is now open.
+ */
+
+/*!
+    \fn void QextSerialPort::disconnected()
+    This signal is emitted when the device of a port bound with bindToDevice()
+    has been removed and the port was closed because of that.
+ */
+
+/*!
+    \fn void QextSerialPort::reconnected(qint64 downtimeMsecs, int attempts)
+    This signal is emitted when a port bound with bindToDevice() has been
+    reopened after its device came back. \a downtimeMsecs is the time since the
+    device was removed, \a attempts the number of open attempts it took.
+ */
+
 /*!
     \fn QueryMode QextSerialPort::queryMode() const
     Get query mode.
@@ -476,12 +1334,77 @@ bool QextSerialPort::open(OpenMode mode)
 {
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
-    if (mode != QIODevice::NotOpen && !isOpen())
+    if (mode != QIODevice::NotOpen && !isOpen() && !d->openPending)
         d->open_sys(mode);
 
     return isOpen();
 }
 
+/*!
+    Starts opening the port with OpenMode \a mode on a worker thread and returns
+    immediately. The opened() signal is emitted in the port's own thread when the
+    device has been opened and configured, or when that failed.
+
+    Returns false if the request could not be started because the port is
+    already open, or an openAsync() is still in progress.
+
+    \sa open(), openAll()
+*/
+bool QextSerialPort::openAsync(OpenMode mode)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (mode == QIODevice::NotOpen || isOpen() || d->openPending)
+        return false;
+    d->openPending = true;
+    d->pendingOpenMode = mode;
+    openPool()->start(new QextSerialOpenTask(d, true));
+    return true;
+}
+
+/*!
+    Opens all \a ports with OpenMode \a mode, running up to \a maxParallel
+    device opens at the same time, and returns the number of ports that are
+    open afterwards. Ports that are already open are left alone.
+
+    Unlike openAsync(), this function blocks until all ports are done. It must
+    be called from the thread the ports live in.
+*/
+int QextSerialPort::openAll(const QList<QextSerialPort *> &ports, OpenMode mode, int maxParallel)
+{
+    QList<QextSerialOpenTask *> tasks;
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(maxParallel, 1));
+    foreach (QextSerialPort *port, ports) {
+        QextSerialPortPrivate *d = port->d_func();
+        {
+            QReadLocker locker(&d->lock);
+            if (mode == QIODevice::NotOpen || port->isOpen() || d->openPending)
+                continue;
+        }
+        QextSerialOpenTask *task = new QextSerialOpenTask(d, false);
+        task->setAutoDelete(false);
+        tasks.append(task);
+        pool.start(task);
+    }
+    pool.waitForDone();
+
+    foreach (QextSerialOpenTask *task, tasks) {
+        if (task->success) {
+            QWriteLocker locker(&task->d->lock);
+            task->d->finishOpen_sys(mode);
+        }
+        delete task;
+    }
+
+    int openCount = 0;
+    foreach (QextSerialPort *port, ports) {
+        if (port->isOpen())
+            ++openCount;
+    }
+    return openCount;
+}
+
 
 /*! \reimp
     Closes a serial port.  This function has no effect if the serial port associated with the class
@@ -491,12 +1414,20 @@ void QextSerialPort::close()
 {
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
+    // an explicit close() ends any pending reconnect
+    d->reconnectMode = NotOpen;
+    if (d->reconnectTimer)
+        d->reconnectTimer->stop();
+    if (d->latencyTimer)
+        d->latencyTimer->stop();
+    d->lastArrival.invalidate();
     if (isOpen()) {
         // Be a good QIODevice and call QIODevice::close() before really close()
         //  so the aboutToClose() signal is emitted at the proper time
         QIODevice::close(); // mark ourselves as closed
         d->close_sys();
         d->readBuffer.clear();
+        d->dropConsumedStamps();
     }
 }
 
@@ -518,12 +1449,14 @@ void QextSerialPort::flush()
 */
 qint64 QextSerialPort::bytesAvailable() const
 {
-    QWriteLocker locker(&d_func()->lock);
+    QextProfiledLocker locker(d_func(), BytesAvailableLock);
     if (isOpen()) {
         qint64 bytes = d_func()->bytesAvailable_sys();
         if (bytes != -1) {
-            return bytes + d_func()->readBuffer.size()
-                    + QIODevice::bytesAvailable();
+            bytes += d_func()->readBuffer.size();
+            if (d_func()->recordSize > 0)
+                bytes -= bytes % d_func()->recordSize;
+            return bytes + QIODevice::bytesAvailable();
         }
         return -1;
     }
@@ -577,6 +1510,8 @@ void QextSerialPort::setPortName(const QString &name)
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
     d->port = name;
+    QMutexLocker registryLocker(&portRegistry()->mutex);
+    d->metricsName = name;
 }
 
 /*!
@@ -615,6 +1550,21 @@ BaudRateType QextSerialPort::baudRate() const
     return d_func()->settings.BaudRate;
 }
 
+/*!
+    Returns the baud rate the driver reports for the open port. This is the rate
+    actually in effect, which may differ from baudRate() when the hardware cannot
+    generate the requested rate exactly.
+
+    Returns 0 if the port is not open, or -1 if the rate could not be read back.
+*/
+int QextSerialPort::actualBaudRate() const
+{
+    QReadLocker locker(&d_func()->lock);
+    if (isOpen())
+        return d_func()->actualBaudRate_sys();
+    return 0;
+}
+
 /*!
     Returns the number of data bits used by the port.  For a list of possible values returned by
     this function, see the definition of the enum DataBitsType.
@@ -667,40 +1617,577 @@ bool QextSerialPort::isSequential() const
 }
 
 /*!
-    Return the error number, or 0 if no error occurred.
+    Returns the record size in bytes, 0 if record mode is disabled.
+
+    \sa setRecordSize()
 */
-ulong QextSerialPort::lastError() const
+int QextSerialPort::recordSize() const
 {
     QReadLocker locker(&d_func()->lock);
-    return d_func()->lastErr;
+    return d_func()->recordSize;
 }
 
 /*!
-    Returns the line status as stored by the port function.  This function will retrieve the states
-    of the following lines: DCD, CTS, DSR, and RI.  On POSIX systems, the following additional lines
-    can be monitored: DTR, RTS, Secondary TXD, and Secondary RXD.  The value returned is an unsigned
-    long with specific bits indicating which lines are high.  The following constants should be used
-    to examine the states of individual lines:
-
-    \code
-    Mask        Line
-    ------      ----
-    LS_CTS      CTS
-    LS_DSR      DSR
-    LS_DCD      DCD
-    LS_RI       RI
-    LS_RTS      RTS (POSIX only)
-    LS_DTR      DTR (POSIX only)
-    LS_ST       Secondary TXD (POSIX only)
-    LS_SR       Secondary RXD (POSIX only)
-    \endcode
+    Returns the busy-poll budget in microseconds, 0 if busy polling is disabled.
 
-    This function will return 0 if the port associated with the class is not currently open.
+    \sa setBusyPollBudget()
 */
-unsigned long QextSerialPort::lineStatus()
+int QextSerialPort::busyPollBudget() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return d_func()->busyPollBudget;
+}
+
+/*!
+    Returns true if the adaptive read controller is enabled.
+
+    \sa setAdaptiveReads()
+*/
+bool QextSerialPort::adaptiveReads() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return d_func()->adaptiveReads;
+}
+
+/*!
+    Returns the latency bound of the adaptive read controller in microseconds.
+
+    \sa setMaxReadLatency()
+*/
+int QextSerialPort::maxReadLatency() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return d_func()->maxReadLatency;
+}
+
+/*!
+    Returns what the adaptive read controller currently measures and decides.
+
+    \sa ReadTuning, setAdaptiveReads()
+*/
+ReadTuning QextSerialPort::readTuning() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return d_func()->tuning;
+}
+
+/*!
+    Returns a snapshot of the port's counters. The counters are cheap enough to
+    be always on; a library built with QESP_NO_STATISTICS defined does not
+    maintain them and returns all zeros.
+
+    The snapshot is not atomic as a whole: each counter is read on its own, so
+    counters updated concurrently by the port's thread may be a few events
+    apart.
+
+    \sa PortStatistics, resetStatistics()
+*/
+PortStatistics QextSerialPort::statistics() const
+{
+    PortStatistics stats;
+#ifndef QESP_NO_STATISTICS
+    const QextPortCounters &c = d_func()->counters;
+    stats.bytesReceived = c.bytesReceived.load();
+    stats.bytesSent = c.bytesSent.load();
+    stats.readCalls = c.readCalls.load();
+    stats.writeCalls = c.writeCalls.load();
+    stats.notifierWakeups = c.notifierWakeups.load();
+    stats.readyReadEmitted = c.readyReadEmitted.load();
+    stats.wouldBlock = c.wouldBlock.load();
+    stats.shortWrites = c.shortWrites.load();
+    stats.rxBufferHighWater = c.rxBufferHighWater.load();
+    stats.rxBufferReallocs = c.rxBufferReallocs.load();
+    stats.settingsApplied = c.settingsApplied.load();
+#else
+    memset(&stats, 0, sizeof(stats));
+#endif
+    return stats;
+}
+
+/*!
+    Sets all counters returned by statistics() back to zero.
+*/
+void QextSerialPort::resetStatistics()
+{
+#ifndef QESP_NO_STATISTICS
+    QextPortCounters &c = d_func()->counters;
+    c.bytesReceived.store(0);
+    c.bytesSent.store(0);
+    c.readCalls.store(0);
+    c.writeCalls.store(0);
+    c.notifierWakeups.store(0);
+    c.readyReadEmitted.store(0);
+    c.wouldBlock.store(0);
+    c.shortWrites.store(0);
+    c.rxBufferHighWater.store(0);
+    c.rxBufferReallocs.store(0);
+    c.settingsApplied.store(0);
+#endif
+}
+
+/*!
+    Enables the latency histograms if \a enable is true. They are off by
+    default and can be switched on and off at any time.
+
+    Three latencies are recorded per port, see LatencyMetric. Each goes into a
+    log-bucketed histogram (8 sub-buckets per power of two, so values are
+    accurate to within 12.5%) that is updated without locks. Query them with
+    latencyPercentile().
+
+    \sa resetLatencyHistograms()
+*/
+void QextSerialPort::setLatencyHistograms(bool enable)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (enable && !d->histogramStorage)
+        d->histogramStorage = new QextLatencyHistograms;
+    d->rxStamp = -1;
+    d->histograms.storeRelease(enable ? d->histogramStorage : 0);
+}
+
+/*!
+    Returns true if the latency histograms are enabled.
+*/
+bool QextSerialPort::latencyHistograms() const
+{
+    return d_func()->histograms.loadAcquire() != 0;
+}
+
+/*!
+    Returns the \a percentile (0 to 100) of \a metric in nanoseconds, for
+    example \c{latencyPercentile(DeliveryLatency, 99.9)}. Returns -1 if no
+    sample has been recorded.
+
+    Samples recorded before the histograms were last disabled are kept and
+    included.
+
+    \sa latencySamples()
+*/
+qint64 QextSerialPort::latencyPercentile(LatencyMetric metric, double percentile) const
+{
+    const QextLatencyHistograms *h = d_func()->histogramStorage;
+    if (!h)
+        return -1;
+    switch (metric) {
+    case DeliveryLatency:
+        return h->delivery.percentile(percentile);
+    case ReadLockHold:
+        return h->readLockHold.percentile(percentile);
+    case WriteDwell:
+        return h->writeDwell.percentile(percentile);
+    }
+    return -1;
+}
+
+/*!
+    Returns the number of samples recorded for \a metric.
+*/
+quint64 QextSerialPort::latencySamples(LatencyMetric metric) const
+{
+    const QextLatencyHistograms *h = d_func()->histogramStorage;
+    if (!h)
+        return 0;
+    switch (metric) {
+    case DeliveryLatency:
+        return h->delivery.samples();
+    case ReadLockHold:
+        return h->readLockHold.samples();
+    case WriteDwell:
+        return h->writeDwell.samples();
+    }
+    return 0;
+}
+
+/*!
+    Discards all samples of the latency histograms.
+*/
+void QextSerialPort::resetLatencyHistograms()
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (QextLatencyHistograms *h = d->histogramStorage) {
+        h->delivery.reset();
+        h->readLockHold.reset();
+        h->writeDwell.reset();
+    }
+}
+
+/*!
+    Starts recording the I/O of all ports to \a fileName in the Trace Event
+    Format, which loads in Perfetto (ui.perfetto.dev) and chrome://tracing.
+    Returns false if a recording is already running or the file cannot be
+    written.
+
+    Each port gets a track of its own in the application's process, holding
+    slices for reads, writes, settings changes, readyRead() dispatch and
+    contended lock waits, and a counter of the bytes buffered for reading.
+    Timestamps are taken from CLOCK_MONOTONIC (the performance counter on
+    Windows), the clock Chrome and the Perfetto SDK stamp their own JSON
+    traces with, so the file lines up with the application's traces.
+
+    Threads record into buffers of their own without taking locks; a
+    background thread writes them out every 100 ms. Events that do not fit
+    are dropped, and the count is stored in the file's \c otherData.
+
+    \sa stopTraceRecording()
+*/
+bool QextSerialPort::startTraceRecording(const QString &fileName)
+{
+    return QextTraceRecorder::start(fileName);
+}
+
+/*!
+    Writes out what is left and closes the recording started by
+    startTraceRecording().
+*/
+void QextSerialPort::stopTraceRecording()
+{
+    QextTraceRecorder::stop();
+}
+
+/*!
+    Returns true while a trace recording is running.
+*/
+bool QextSerialPort::isTraceRecording()
+{
+    return QextTraceRecorder::isActive();
+}
+
+/*!
+    Starts recording everything the port receives and sends to \a fileName,
+    with timestamps and direction. Returns false if a capture is already
+    running or the file cannot be written.
+
+    The I/O paths only copy the data into preallocated buffers (4 x 64 KiB
+    per direction); a background thread shared by all ports writes them out
+    in blocks, LZ4 compressed if \a compress is true and the library was
+    built with \c{CONFIG += qesp_lz4}. If the disk falls behind and no
+    buffer is free, data is dropped rather than blocking the port; see
+    captureStatistics().
+
+    If \a maxFileSize is positive, a new file is started once the current
+    one exceeds it: \c{name.qcap}, \c{name.1.qcap}, \c{name.2.qcap} and so
+    on. Each file ends with an index of its blocks by time. The format is
+    described in qextserialcapture_p.h.
+
+    \sa stopCapture()
+*/
+bool QextSerialPort::startCapture(const QString &fileName, qint64 maxFileSize, bool compress)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (d->capture.loadAcquire())
+        return false;
+    if (!d->captureStorage)
+        d->captureStorage = new QextCapture;
+    QextCaptureOptions options;
+    options.fileName = fileName;
+    options.portName = d->port;
+    options.maxFileSize = maxFileSize;
+    options.compress = compress;
+    if (!d->captureStorage->start(options))
+        return false;
+    d->capture.storeRelease(d->captureStorage);
+    return true;
+}
+
+/*!
+    Starts a capture like startCapture(), but writes a pcapng file that
+    Wireshark and tcpdump can read. Returns false if a capture is already
+    running or the file cannot be written.
+
+    The port appears as two interfaces, "<port> rx" and "<port> tx", with
+    link type \c{LINKTYPE_USER0 + userLinkType} (147 to 162), so a
+    dissector can be assigned to it. Ports that capture into the same
+    \a fileName share one file, which makes it easy to follow a
+    conversation across several ports.
+
+    The serial data is cut into packets: records of recordSize() bytes if
+    the port has one, otherwise whatever arrives without a pause longer than
+    \a frameGapUsecs microseconds. The default of 0 uses 3.5 character times
+    at the current baud rate, but at least 1 ms. A packet carries the
+    timestamp of its first byte, in nanoseconds, and is only written when
+    the next packet starts or the capture stops.
+
+    \sa stopCapture(), captureStatistics()
+*/
+bool QextSerialPort::startPcapCapture(const QString &fileName, int userLinkType, int frameGapUsecs)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (d->capture.loadAcquire() || userLinkType < 0 || userLinkType > 15)
+        return false;
+    if (!d->captureStorage)
+        d->captureStorage = new QextCapture;
+    QextCaptureOptions options;
+    options.fileName = fileName;
+    options.portName = d->port;
+    options.format = QextCaptureOptions::Pcapng;
+    options.linkType = QextPcapngFile::LinkTypeUser0 + userLinkType;
+    options.recordSize = d->recordSize;
+    if (frameGapUsecs > 0)
+        options.frameGap = qint64(frameGapUsecs) * 1000;
+    else  // 3.5 characters of about 10 bits each
+        options.frameGap = qMax(Q_INT64_C(1000000), Q_INT64_C(35000000000) / qMax(int(d->settings.BaudRate), 1));
+    if (!d->captureStorage->start(options))
+        return false;
+    d->capture.storeRelease(d->captureStorage);
+    return true;
+}
+
+/*!
+    Writes out the buffered data and closes the capture file.
+*/
+void QextSerialPort::stopCapture()
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (QextCapture *capture = d->capture.fetchAndStoreOrdered(0))
+        capture->stop();
+}
+
+/*!
+    Returns true while a capture is running.
+*/
+bool QextSerialPort::isCapturing() const
+{
+    return d_func()->capture.loadAcquire() != 0;
+}
+
+/*!
+    Returns the counters of the running or last capture. bytesWritten
+    counts what went to disk, after compression.
+*/
+CaptureStatistics QextSerialPort::captureStatistics() const
+{
+    CaptureStatistics stats = CaptureStatistics();
+    if (const QextCapture *capture = d_func()->captureStorage) {
+        stats.bytesCaptured = capture->bytesCaptured.load();
+        stats.recordsCaptured = capture->recordsCaptured.load();
+        stats.bytesDropped = capture->bytesDropped.load();
+        stats.recordsDropped = capture->recordsDropped.load();
+        stats.bytesWritten = capture->bytesWritten.load();
+        stats.filesWritten = capture->filesWritten.load();
+    }
+    return stats;
+}
+
+/*!
+    Enables receive timestamps if \a enable is true. They are off by
+    default.
+
+    While enabled, the port notes the time of every read from the driver, in
+    nanoseconds on the monotonic clock (the clock of QElapsedTimer), and
+    readTimestamped() returns the received data together with these times.
+    This is what QextSerialMerger orders the data of several ports by.
+    The port may still be read with read() or readAll(); the times of the
+    bytes read that way are dropped with them.
+
+    \sa readTimestamped()
+*/
+void QextSerialPort::setReceiveTimestamps(bool enable)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    d->rxTimestamps = enable;
+    if (!enable) {
+        d->rxStamps.clear();
+        d->rxStampHead = 0;
+        d->rxStampedBytes = 0;
+    }
+}
+
+/*!
+    Returns true if receive timestamps are enabled.
+*/
+bool QextSerialPort::receiveTimestamps() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return d_func()->rxTimestamps;
+}
+
+/*!
+    Reads the oldest received bytes that arrived together and stores the
+    time they were received in \a timestamp. Returns an empty array, and -1
+    in \a timestamp, if nothing is buffered.
+
+    The bytes of one driver read are returned as one array, regardless of
+    recordSize(). Data buffered before receive timestamps were enabled is
+    returned first, with the time of the oldest stamped read. Data already
+    taken by QIODevice's own buffer, e.g. by peek() or canReadLine(), is not
+    seen here, so a port should be read with either read() or this
+    function.
+
+    \sa setReceiveTimestamps()
+*/
+QByteArray QextSerialPort::readTimestamped(qint64 *timestamp)
+{
+    Q_D(QextSerialPort);
+    QextProfiledLocker locker(d, ReadDataLock);
+    *timestamp = -1;
+    if (!isOpen())
+        return QByteArray();
+    if (d->queryMode == Polling)
+        d->fillReadBuffer();
+    QByteArray data = d->takeStamped(timestamp);
+    if (d->readBuffer.isEmpty())
+        d->rxStamp = -1;
+    return data;
+}
+
+/*!
+    Enables lock profiling if \a enable is true. It is off by default and
+    can be switched on and off at any time.
+
+    While enabled, the port records how long each acquisition of its internal
+    lock waited and how long the lock was then held, separately for the call
+    sites listed in LockSite. That shows whether a thread reading the port and
+    another writing to it hold each other up. Recording uses atomics only and
+    adds two clock reads per acquisition; while disabled the cost is a single
+    atomic load.
+
+    \sa lockProfile(), lockProfileReport(), resetLockProfile()
+*/
+void QextSerialPort::setLockProfiling(bool enable)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (enable && !d->lockProfileStorage)
+        d->lockProfileStorage = new QextLockProfiles;
+    d->lockProfiles.storeRelease(enable ? d->lockProfileStorage : 0);
+}
+
+/*!
+    Returns true if lock profiling is enabled.
+*/
+bool QextSerialPort::lockProfiling() const
+{
+    return d_func()->lockProfiles.loadAcquire() != 0;
+}
+
+/*!
+    Returns the lock waits and hold times recorded at \a site, in
+    nanoseconds. An acquisition counts as contended if the lock was not
+    free right away; the percentiles are over all acquisitions and accurate
+    to within 12.5%. Hold times of nested acquisitions overlap.
+*/
+LockSiteProfile QextSerialPort::lockProfile(LockSite site) const
+{
+    LockSiteProfile profile = LockSiteProfile();
+    const QextLockProfiles *profiles = d_func()->lockProfileStorage;
+    if (!profiles || int(site) < 0 || int(site) >= int(QextLockProfiles::Sites))
+        return profile;
+    const QextLockSiteStats &stats = profiles->sites[site];
+    profile.acquisitions = stats.acquisitions.load();
+    profile.contended = stats.contended.load();
+    profile.totalWait = qint64(stats.totalWait.load());
+    profile.maxWait = qint64(stats.maxWait.load());
+    profile.p99Wait = qMax(stats.wait.percentile(99), qint64(0));
+    profile.totalHold = qint64(stats.totalHold.load());
+    profile.maxHold = qint64(stats.maxHold.load());
+    profile.p99Hold = qMax(stats.hold.percentile(99), qint64(0));
+    return profile;
+}
+
+/*!
+    Returns lockProfile() of every site as a table for logs, times in
+    microseconds.
+*/
+QString QextSerialPort::lockProfileReport() const
+{
+    static const char *const siteNames[] = {
+        "readData", "writeData", "bytesAvailable", "lineStatus", "setters"
+    };
+    QString report = QString::fromLatin1("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+            .arg(QLatin1String("site"), -15).arg(QLatin1String("acquired"), 10)
+            .arg(QLatin1String("contended"), 10).arg(QLatin1String("wait avg"), 10)
+            .arg(QLatin1String("wait p99"), 10).arg(QLatin1String("wait max"), 10)
+            .arg(QLatin1String("hold avg"), 10).arg(QLatin1String("hold p99"), 10)
+            .arg(QLatin1String("hold max"), 10);
+    for (int site = 0; site < QextLockProfiles::Sites; ++site) {
+        LockSiteProfile p = lockProfile(LockSite(site));
+        double n = qMax(p.acquisitions, quint64(1));
+        report += QString::fromLatin1("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+                .arg(QLatin1String(siteNames[site]), -15)
+                .arg(p.acquisitions, 10).arg(p.contended, 10)
+                .arg(p.totalWait / n / 1000, 10, 'f', 1).arg(p.p99Wait / 1000.0, 10, 'f', 1)
+                .arg(p.maxWait / 1000.0, 10, 'f', 1)
+                .arg(p.totalHold / n / 1000, 10, 'f', 1).arg(p.p99Hold / 1000.0, 10, 'f', 1)
+                .arg(p.maxHold / 1000.0, 10, 'f', 1);
+    }
+    return report;
+}
+
+/*!
+    Clears the recorded lock profile.
+*/
+void QextSerialPort::resetLockProfile()
 {
     Q_D(QextSerialPort);
     QWriteLocker locker(&d->lock);
+    if (QextLockProfiles *profiles = d->lockProfileStorage) {
+        for (int site = 0; site < QextLockProfiles::Sites; ++site) {
+            QextLockSiteStats &stats = profiles->sites[site];
+            stats.acquisitions.store(0);
+            stats.contended.store(0);
+            stats.totalWait.store(0);
+            stats.maxWait.store(0);
+            stats.totalHold.store(0);
+            stats.maxHold.store(0);
+            stats.wait.reset();
+            stats.hold.reset();
+        }
+    }
+}
+
+/*!
+    Returns true if the port switches between notifier and batched polling
+    depending on the traffic.
+
+    \sa setAdaptivePolling()
+*/
+bool QextSerialPort::adaptivePolling() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return d_func()->adaptivePolling;
+}
+
+/*!
+    Return the error number, or 0 if no error occurred.
+*/
+ulong QextSerialPort::lastError() const
+{
+    QReadLocker locker(&d_func()->lock);
+    return d_func()->lastErr;
+}
+
+/*!
+    Returns the line status as stored by the port function.  This function will retrieve the states
+    of the following lines: DCD, CTS, DSR, and RI.  On POSIX systems, the following additional lines
+    can be monitored: DTR, RTS, Secondary TXD, and Secondary RXD.  The value returned is an unsigned
+    long with specific bits indicating which lines are high.  The following constants should be used
+    to examine the states of individual lines:
+
+    \code
+    Mask        Line
+    ------      ----
+    LS_CTS      CTS
+    LS_DSR      DSR
+    LS_DCD      DCD
+    LS_RI       RI
+    LS_RTS      RTS (POSIX only)
+    LS_DTR      DTR (POSIX only)
+    LS_ST       Secondary TXD (POSIX only)
+    LS_SR       Secondary RXD (POSIX only)
+    \endcode
+
+    This function will return 0 if the port associated with the class is not currently open.
+*/
+unsigned long QextSerialPort::lineStatus()
+{
+    Q_D(QextSerialPort);
+    QextProfiledLocker locker(d, LineStatusLock);
     if (isOpen())
         return d->lineStatus_sys();
     return 0;
@@ -755,11 +2242,169 @@ QString QextSerialPort::errorString()
     }
 }
 
+/*!
+    Replaces all port settings with \a settings in one step.
+
+    Only the fields that differ from the current settings are marked as changed,
+    and an open port is reconfigured with a single system call at the moment
+    given by \a when. Nothing is touched at all if \a settings equals the current
+    settings. ApplyDrain and ApplyFlush block until the pending output has been
+    transmitted.
+
+    \sa beginSettings(), commitSettings()
+*/
+void QextSerialPort::applySettings(const PortSettings &settings, ApplyMode when)
+{
+    Q_D(QextSerialPort);
+    QextProfiledLocker locker(d, SettersLock);
+    if (d->settings.BaudRate != settings.BaudRate)
+        d->setBaudRate(settings.BaudRate, false);
+    if (d->settings.DataBits != settings.DataBits)
+        d->setDataBits(settings.DataBits, false);
+    if (d->settings.StopBits != settings.StopBits)
+        d->setStopBits(settings.StopBits, false);
+    if (d->settings.Parity != settings.Parity)
+        d->setParity(settings.Parity, false);
+    if (d->settings.FlowControl != settings.FlowControl)
+        d->setFlowControl(settings.FlowControl, false);
+    if (d->settings.Timeout_Millisec != settings.Timeout_Millisec)
+        d->setTimeout(settings.Timeout_Millisec, false);
+    if (isOpen())
+        d->updatePortSettings(when);
+}
+
+/*!
+    Starts a settings transaction. Until the matching commitSettings(), the
+    setters (setBaudRate(), setParity(), ...) only record the new values; the
+    port is reconfigured once when the transaction is committed.
+
+    Transactions may be nested, only the outermost commitSettings() applies.
+*/
+void QextSerialPort::beginSettings()
+{
+    Q_D(QextSerialPort);
+    QextProfiledLocker locker(d, SettersLock);
+    ++d->settingsTransaction;
+}
+
+/*!
+    Ends a settings transaction started with beginSettings() and applies all
+    recorded changes with a single system call at the moment given by \a when.
+    Pass ApplyDrain to switch only after the pending output has been
+    transmitted, or ApplyFlush to also discard the input received so far.
+*/
+void QextSerialPort::commitSettings(ApplyMode when)
+{
+    Q_D(QextSerialPort);
+    QextProfiledLocker locker(d, SettersLock);
+    if (d->settingsTransaction > 0 && --d->settingsTransaction == 0 && isOpen())
+        d->updatePortSettings(when);
+}
+
+/*!
+    Binds the port to the device described by \a identity instead of a fixed
+    device name. Typical identities are the USB serial number, the vendor and
+    product ID together with the locationPath, or a /dev/serial/by-id link as
+    persistentName (see QextPortInfo).
+
+    The port name follows the device: if a matching device is connected it is
+    used right away, otherwise as soon as one shows up. When the device of an
+    open port disappears, the port is closed and disconnected() is emitted; once
+    a matching device appears again the port is reopened with the same open
+    mode and settings, and reconnected() is emitted. Nothing is polled, the port
+    relies on the hotplug notifications of QextSerialEnumerator, so this only
+    works where those are available (Windows, OS X, Linux with udev). Linux
+    builds without udev (QESP_NO_UDEV) have none: there the binding neither
+    resolves the port name nor sees a device come or go, and the enumerator
+    only warns "Setup Notification Failed". Use a fixed port name on those.
+
+    Calling close() cancels a pending reconnect, a later open() re-arms it.
+
+    \sa unbindDevice(), setReconnectBackoff()
+*/
+void QextSerialPort::bindToDevice(const QextPortFilter &identity)
+{
+    Q_D(QextSerialPort);
+    {
+        QWriteLocker locker(&d->lock);
+        d->boundIdentity = identity;
+        d->bound = true;
+    }
+    // the enumerator's signals call back into the port, which locks again
+    if (!d->hotplug) {
+        d->hotplug = new QextSerialEnumerator(this);
+        connect(d->hotplug, &QextSerialEnumerator::deviceDiscovered, this,
+                [d](const QextPortInfo &info){d->_q_deviceDiscovered(info);});
+        connect(d->hotplug, &QextSerialEnumerator::deviceRemoved, this,
+                [d](const QextPortInfo &info){d->_q_deviceRemoved(info);});
+        // reports the devices already present, which resolves the port name
+        d->hotplug->setUpNotifications();
+    } else if (!isOpen()) {
+        // findPorts() already matched the identity
+        QList<QextPortInfo> ports = QextSerialEnumerator::findPorts(identity);
+        if (!ports.isEmpty())
+            d->followDevice(ports.first());
+    }
+}
+
+/*!
+    Releases the binding made with bindToDevice(). The port keeps its current
+    name and state, but is no longer reopened automatically.
+*/
+void QextSerialPort::unbindDevice()
+{
+    Q_D(QextSerialPort);
+    {
+        QWriteLocker locker(&d->lock);
+        d->bound = false;
+        d->reconnectMode = NotOpen;
+        if (d->reconnectTimer)
+            d->reconnectTimer->stop();
+    }
+    delete d->hotplug;
+    d->hotplug = 0;
+}
+
+/*!
+    Returns true if the port is bound to a device identity.
+    \sa bindToDevice()
+*/
+bool QextSerialPort::isBoundToDevice() const
+{
+    Q_D(const QextSerialPort);
+    QReadLocker locker(&d->lock);
+    return d->bound;
+}
+
+/*!
+    Sets the delays used when reopening a bound port fails: the first retry
+    happens after \a initialMsecs, every further one waits twice as long, up to
+    \a maxMsecs. The defaults are 100 and 5000 milliseconds.
+
+    Retries only happen after a matching device has appeared, and stop when it
+    disappears again.
+*/
+void QextSerialPort::setReconnectBackoff(int initialMsecs, int maxMsecs)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    d->reconnectInitialDelay = qMax(1, initialMsecs);
+    d->reconnectMaxDelay = qMax(d->reconnectInitialDelay, maxMsecs);
+}
+
 /*!
    Destructs the QextSerialPort object.
 */
 QextSerialPort::~QextSerialPort()
 {
+    Q_D(QextSerialPort);
+    if (d->openPending) {
+        // wait for the worker, then release the device it may have opened
+        d->openDone.acquire();
+        d->openPending = false;
+        if (d->pendingOpenResult)
+            d->close_sys();
+    }
     if (isOpen())
         close();
 
@@ -777,7 +2422,7 @@ QextSerialPort::~QextSerialPort()
 void QextSerialPort::setFlowControl(FlowType flow)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (d->settings.FlowControl != flow)
         d->setFlowControl(flow, true);
 }
@@ -795,7 +2440,7 @@ void QextSerialPort::setFlowControl(FlowType flow)
 void QextSerialPort::setParity(ParityType parity)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (d->settings.Parity != parity)
         d->setParity(parity, true);
 }
@@ -820,7 +2465,7 @@ void QextSerialPort::setParity(ParityType parity)
 void QextSerialPort::setDataBits(DataBitsType dataBits)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (d->settings.DataBits != dataBits)
         d->setDataBits(dataBits, true);
 }
@@ -844,7 +2489,7 @@ void QextSerialPort::setDataBits(DataBitsType dataBits)
 void QextSerialPort::setStopBits(StopBitsType stopBits)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (d->settings.StopBits != stopBits)
         d->setStopBits(stopBits, true);
 }
@@ -894,12 +2539,16 @@ void QextSerialPort::setStopBits(StopBitsType stopBits)
        BAUD3500000              X     3500000
        BAUD4000000              X     4000000
     \endcode
+
+    Windows, OS X and Linux also accept rates that are not listed above, for example
+    \c{setBaudRate(BaudRateType(250000))}. On Linux such rates are set through the
+    termios2 interface; use actualBaudRate() to check what the driver applied.
 */
 
 void QextSerialPort::setBaudRate(BaudRateType baudRate)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (d->settings.BaudRate != baudRate)
         d->setBaudRate(baudRate, true);
 }
@@ -933,11 +2582,129 @@ void QextSerialPort::setBaudRate(BaudRateType baudRate)
 void QextSerialPort::setTimeout(long millisec)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (d->settings.Timeout_Millisec != millisec)
         d->setTimeout(millisec, true);
 }
 
+/*!
+    Switches the port to record mode with records of \a bytes bytes, for devices
+    that send fixed-size blocks. A size of 0 (the default) disables record mode.
+
+    In record mode, data is only handed out in whole records: bytesAvailable() is
+    always a multiple of the record size, readData() never returns a partial
+    record and, for EventDriven ports, readyRead() is only emitted once at least
+    one complete record has arrived. Reads should therefore ask for multiples of
+    the record size.
+
+    On POSIX systems a Polling port also programs the driver to wait for a whole
+    record (VMIN, at most 255 bytes) before waking up the reader. The timeout set
+    with setTimeout() then acts as the inter-byte timeout, rounded to tenths of
+    a second and at least 100 ms, and a read blocks until the first byte arrives
+    unless the timeout is -1.
+*/
+void QextSerialPort::setRecordSize(int bytes)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    bytes = qMax(bytes, 0);
+    if (d->recordSize != bytes) {
+        d->recordSize = bytes;
+        d->settingsDirtyFlags |= QextSerialPortPrivate::DFE_RecordSize;
+        d->updatePortSettings();
+    }
+}
+
+/*!
+    Sets the busy-poll budget to \a usecs microseconds.
+
+    When the budget is greater than 0, an EventDriven port keeps spinning on
+    non-blocking reads for up to \a usecs after each write and after each
+    readyRead() delivery, before falling back to the event loop. This trades
+    CPU time for response latency on request/response links. Data picked up
+    after a write is announced by a queued readyRead(). Writes from a thread
+    other than the port's do not poll.
+
+    A budget of 0 (the default) disables busy polling.
+
+    \bold note: currently only implemented on POSIX systems. On Windows the
+    budget is accepted but has no effect.
+
+    \sa setAdaptivePolling()
+*/
+void QextSerialPort::setBusyPollBudget(int usecs)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    d->busyPollBudget = qMax(usecs, 0);
+}
+
+/*!
+    Enables adaptive polling if \a enable is true.
+
+    With adaptive polling an EventDriven port switches from per-wakeup
+    notifications to a batched, timer driven poll while traffic is heavy, and
+    back to notifications once the line goes quiet.
+
+    \bold note: currently only implemented on POSIX systems.
+*/
+void QextSerialPort::setAdaptivePolling(bool enable)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (d->adaptivePolling != enable) {
+        d->adaptivePolling = enable;
+        if (!enable && isOpen())
+            d->updatePollMode_sys(-1);
+    }
+}
+
+/*!
+    Enables the adaptive read controller if \a enable is true.
+
+    The controller watches the gaps between arrivals and the size of the chunks
+    an EventDriven port receives, and tunes three things on every wakeup: how
+    many bytes are collected before readyRead() is emitted, how much is asked
+    for per read, and in which steps the read buffer grows. Bursts and steady
+    streams are then delivered in batches with fewer wakeups of the reader,
+    while sparse request/response traffic is announced immediately. Buffered
+    data never waits longer than maxReadLatency() for its readyRead().
+
+    The current decisions are available from readTuning(). Disabling the
+    controller resets them.
+
+    \sa setMaxReadLatency(), setAdaptivePolling()
+*/
+void QextSerialPort::setAdaptiveReads(bool enable)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    if (d->adaptiveReads != enable) {
+        d->adaptiveReads = enable;
+        d->resetReadTuning();
+        d->readBuffer.setGrowth(size_t(d->tuning.bufferReserve));
+        if (!enable && d->latencyTimer && d->latencyTimer->isActive()) {
+            d->latencyTimer->stop();
+            if (d->canAnnounce())
+                d->emitReadyRead();
+        }
+    }
+}
+
+/*!
+    Sets the longest time, \a usecs microseconds, the adaptive read controller
+    may hold back received data before emitting readyRead(). The default is
+    2000. The bound is enforced with a timer of millisecond resolution.
+
+    \sa setAdaptiveReads()
+*/
+void QextSerialPort::setMaxReadLatency(int usecs)
+{
+    Q_D(QextSerialPort);
+    QWriteLocker locker(&d->lock);
+    d->maxReadLatency = qMax(usecs, 1);
+}
+
 /*!
     Sets DTR line to the requested state (\a set default to high).  This function will have no effect if
     the port associated with the class is not currently open.
@@ -945,7 +2712,7 @@ void QextSerialPort::setTimeout(long millisec)
 void QextSerialPort::setDtr(bool set)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (isOpen())
         d->setDtr_sys(set);
 }
@@ -958,7 +2725,7 @@ void QextSerialPort::setDtr(bool set)
 void QextSerialPort::setRts(bool set)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QextProfiledLocker locker(d, SettersLock);
     if (isOpen())
         d->setRts_sys(set);
 }
@@ -974,14 +2741,56 @@ void QextSerialPort::setRts(bool set)
 qint64 QextSerialPort::readData(char *data, qint64 maxSize)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
+    QESP_PROBE_TIMER(probeStart, read_data);
+    qint64 start = d->traceStart();
+    qint64 bytesRead = d->readData(data, maxSize);
+    d->traceSlice("read", start, bytesRead);
+    QESP_PROBE4(read_data, d->port.toLocal8Bit().constData(), maxSize, bytesRead, QESP_PROBE_ELAPSED(probeStart));
+    return bytesRead;
+}
+
+/*
+    Body of QextSerialPort::readData(): hands out buffered bytes first, then
+    reads the device directly.
+*/
+qint64 QextSerialPortPrivate::readData(char *data, qint64 maxSize)
+{
+    qint64 waitStart = traceStart();
+    QextProfiledLocker locker(this, QextSerialPort::ReadDataLock);
+    traceLockWait(waitStart);
+    QextLatencyScope lockHold(this, &QextLatencyHistograms::readLockHold);
+    if (QextLatencyHistograms *h = histograms.loadAcquire()) {
+        // bytes buffered by _q_canRead() are delivered now
+        if (rxStamp >= 0 && !readBuffer.isEmpty()) {
+            qint64 now = clock.nsecsElapsed();
+            h->delivery.record(now - rxStamp);
+            rxStamp = now;
+        }
+    }
+    if (recordSize > 0) {
+        // readBuffer belongs to the port's thread in EventDriven mode, where
+        // _q_canRead() tops it up; only whole records buffered are handed out
+        if (queryMode == QextSerialPort::Polling && readBuffer.size() < recordSize)
+            fillReadBuffer(recordSize - readBuffer.size());
+        qint64 wholeRecords = qMin(maxSize, qint64(readBuffer.size()));
+        wholeRecords -= wholeRecords % recordSize;
+        wholeRecords = readBuffer.read(data, int(wholeRecords));
+        if (rxStampedBytes)
+            dropConsumedStamps();
+        return wholeRecords;
+    }
     qint64 bytesFromBuffer = 0;
-    if (!d->readBuffer.isEmpty()) {
-        bytesFromBuffer = d->readBuffer.read(data, maxSize);
+    if (!readBuffer.isEmpty()) {
+        bytesFromBuffer = readBuffer.read(data, maxSize);
+        if (rxStampedBytes)
+            dropConsumedStamps();
         if (bytesFromBuffer == maxSize)
             return bytesFromBuffer;
     }
-    qint64 bytesFromDevice = d->readData_sys(data+bytesFromBuffer, maxSize-bytesFromBuffer);
+    qint64 bytesFromDevice = readData_sys(data+bytesFromBuffer, maxSize-bytesFromBuffer);
+    captureData(QextCapture::Rx, data+bytesFromBuffer, bytesFromDevice);
+    if (readBuffer.isEmpty())
+        rxStamp = -1;
     if (bytesFromDevice < 0)
         return -1;
     return bytesFromBuffer + bytesFromDevice;
@@ -998,8 +2807,36 @@ qint64 QextSerialPort::readData(char *data, qint64 maxSize)
 qint64 QextSerialPort::writeData(const char *data, qint64 maxSize)
 {
     Q_D(QextSerialPort);
-    QWriteLocker locker(&d->lock);
-    return d->writeData_sys(data, maxSize);
+    QextLatencyHistograms *histograms = d->histograms.loadAcquire();
+    qint64 start = histograms ? d->clock.nsecsElapsed() : 0;
+    qint64 traceStart = d->traceStart();
+    qint64 bytesWritten;
+    {
+        QextProfiledLocker locker(d, WriteDataLock);
+        d->traceLockWait(traceStart);
+        bytesWritten = d->writeData_sys(data, maxSize);
+        d->captureData(QextCapture::Tx, data, bytesWritten);
+        d->traceSlice("write", traceStart, bytesWritten);
+        if (histograms && bytesWritten > 0) {
+            // time spent waiting for the lock and in the driver, plus the time
+            // the bytes queued ahead of the last one still need to go out
+            histograms->writeDwell.record(d->clock.nsecsElapsed() - start + d->outputQueueDelay_sys());
+        }
+    }
+    // readBuffer is filled by the port's own thread only, see _q_canRead(),
+    // which polls without the lock as well: other threads are not held up
+    if (bytesWritten > 0 && d->busyPollBudget > 0 && d->queryMode == EventDriven
+            && QThread::currentThread() == thread()) {
+        qint64 bytesRead = d->busyPoll();
+        if (bytesRead > 0) {
+            d->stampArrival(bytesRead);
+            QMetaObject::invokeMethod(this, [this] {
+                if (d_func()->canAnnounce())
+                    d_func()->emitReadyRead();
+            }, Qt::QueuedConnection);
+        }
+    }
+    return bytesWritten;
 }
 
 #include "moc_qextserialport.cpp"
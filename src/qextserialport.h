@@ -33,6 +33,7 @@
 #define _QEXTSERIALPORT_H_
 
 #include <QtCore/QIODevice>
+#include <QtCore/QList>
 #include "qextserialport_global.h"
 #ifdef Q_OS_UNIX
 #include <termios.h>
@@ -164,12 +165,77 @@ struct PortSettings
     long Timeout_Millisec;
 };
 
+/**
+ * structure to contain port statistics
+ */
+struct PortStatistics
+{
+    quint64 bytesReceived;
+    quint64 bytesSent;
+    quint64 readCalls;
+    quint64 writeCalls;
+    quint64 notifierWakeups;
+    quint64 readyReadEmitted;
+    quint64 wouldBlock;
+    quint64 shortWrites;
+    quint64 rxBufferHighWater;
+    quint64 rxBufferReallocs;
+    quint64 settingsApplied;
+};
+
+/**
+ * decisions of the adaptive read controller
+ */
+struct ReadTuning
+{
+    qint64 meanGapUsecs;
+    int meanChunkBytes;
+    int notifyThreshold;
+    int readChunkSize;
+    int bufferReserve;
+    qint64 wakeups;
+    qint64 coalescedWakeups;
+    qint64 latencyFlushes;
+};
+
+/**
+ * lock wait and hold times at one call site, in nanoseconds
+ */
+struct LockSiteProfile
+{
+    quint64 acquisitions;
+    quint64 contended;
+    qint64 totalWait;
+    qint64 maxWait;
+    qint64 p99Wait;
+    qint64 totalHold;
+    qint64 maxHold;
+    qint64 p99Hold;
+};
+
+/**
+ * counters of a capture started with startCapture()
+ */
+struct CaptureStatistics
+{
+    quint64 bytesCaptured;
+    quint64 recordsCaptured;
+    quint64 bytesDropped;
+    quint64 recordsDropped;
+    quint64 bytesWritten;
+    quint64 filesWritten;
+};
+
+struct QextPortFilter;
 class QextSerialPortPrivate;
 class QEXTSERIALPORT_EXPORT QextSerialPort: public QIODevice
 {
     Q_OBJECT
     Q_DECLARE_PRIVATE(QextSerialPort)
     Q_ENUMS(QueryMode)
+    Q_ENUMS(ApplyMode)
+    Q_ENUMS(LatencyMetric)
+    Q_ENUMS(LockSite)
     Q_PROPERTY(QString portName READ portName WRITE setPortName)
     Q_PROPERTY(QueryMode queryMode READ queryMode WRITE setQueryMode)
 public:
@@ -178,6 +244,26 @@ public:
         EventDriven
     };
 
+    enum ApplyMode {
+        ApplyNow,
+        ApplyDrain,
+        ApplyFlush
+    };
+
+    enum LatencyMetric {
+        DeliveryLatency,
+        ReadLockHold,
+        WriteDwell
+    };
+
+    enum LockSite {
+        ReadDataLock,
+        WriteDataLock,
+        BytesAvailableLock,
+        LineStatusLock,
+        SettersLock
+    };
+
     explicit QextSerialPort(QueryMode mode = EventDriven, QObject *parent = 0);
     explicit QextSerialPort(const QString &name, QueryMode mode = EventDriven, QObject *parent = 0);
     explicit QextSerialPort(const PortSettings &s, QueryMode mode = EventDriven, QObject *parent = 0);
@@ -188,12 +274,15 @@ public:
     QString portName() const;
     QueryMode queryMode() const;
     BaudRateType baudRate() const;
+    int actualBaudRate() const;
     DataBitsType dataBits() const;
     ParityType parity() const;
     StopBitsType stopBits() const;
     FlowType flowControl() const;
 
     bool open(OpenMode mode);
+    bool openAsync(OpenMode mode);
+    static int openAll(const QList<QextSerialPort *> &ports, OpenMode mode, int maxParallel = 8);
     bool isSequential() const;
     void close();
     void flush();
@@ -203,9 +292,53 @@ public:
 
     ulong lastError() const;
 
+    int recordSize() const;
+    int busyPollBudget() const;
+    bool adaptivePolling() const;
+    bool adaptiveReads() const;
+    int maxReadLatency() const;
+    ReadTuning readTuning() const;
+    PortStatistics statistics() const;
+    void resetStatistics();
+
+    void setLatencyHistograms(bool enable);
+    bool latencyHistograms() const;
+    qint64 latencyPercentile(LatencyMetric metric, double percentile) const;
+    quint64 latencySamples(LatencyMetric metric) const;
+    void resetLatencyHistograms();
+
+    static bool startTraceRecording(const QString &fileName);
+    static void stopTraceRecording();
+    static bool isTraceRecording();
+
+    bool startCapture(const QString &fileName, qint64 maxFileSize = 0, bool compress = false);
+    bool startPcapCapture(const QString &fileName, int userLinkType = 0, int frameGapUsecs = 0);
+    void stopCapture();
+    bool isCapturing() const;
+    CaptureStatistics captureStatistics() const;
+
+    void setReceiveTimestamps(bool enable);
+    bool receiveTimestamps() const;
+    QByteArray readTimestamped(qint64 *timestamp);
+
+    void setLockProfiling(bool enable);
+    bool lockProfiling() const;
+    LockSiteProfile lockProfile(LockSite site) const;
+    QString lockProfileReport() const;
+    void resetLockProfile();
+
     ulong lineStatus();
     QString errorString();
 
+    void applySettings(const PortSettings &settings, ApplyMode when = ApplyNow);
+    void beginSettings();
+    void commitSettings(ApplyMode when = ApplyNow);
+
+    void bindToDevice(const QextPortFilter &identity);
+    void unbindDevice();
+    bool isBoundToDevice() const;
+    void setReconnectBackoff(int initialMsecs, int maxMsecs);
+
 public Q_SLOTS:
     void setPortName(const QString &name);
     void setQueryMode(QueryMode mode);
@@ -215,12 +348,20 @@ public Q_SLOTS:
     void setStopBits(StopBitsType);
     void setFlowControl(FlowType);
     void setTimeout(long);
+    void setRecordSize(int bytes);
+    void setBusyPollBudget(int usecs);
+    void setAdaptivePolling(bool enable);
+    void setAdaptiveReads(bool enable);
+    void setMaxReadLatency(int usecs);
 
     void setDtr(bool set=true);
     void setRts(bool set=true);
 
 Q_SIGNALS:
     void dsrChanged(bool status);
+    void opened(bool success);
+    void disconnected();
+    void reconnected(qint64 downtimeMsecs, int attempts);
 
 protected:
     qint64 readData(char *data, qint64 maxSize);
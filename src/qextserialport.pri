@@ -1,16 +1,33 @@
+lessThan(QT_MAJOR_VERSION, 5)|if(equals(QT_MAJOR_VERSION, 5):lessThan(QT_MINOR_VERSION, 10)) {
+    error("QextSerialPort needs Qt 5.10 or newer")
+}
+
 INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
 PUBLIC_HEADERS         += $$PWD/qextserialport.h \
                           $$PWD/qextserialenumerator.h \
+                          $$PWD/qextserialmetrics.h \
+                          $$PWD/qextserialmerger.h \
+                          $$PWD/qextserialreplayer.h \
                           $$PWD/qextserialport_global.h
 
 HEADERS                += $$PUBLIC_HEADERS \
                           $$PWD/qextserialport_p.h \
                           $$PWD/qextserialenumerator_p.h \
+                          $$PWD/qextserialcapture_p.h \
+                          $$PWD/qextserialmetrics_p.h \
+                          $$PWD/qextserialmerger_p.h \
+                          $$PWD/qextserialreplayer_p.h \
+                          $$PWD/qextserialtrace_p.h
 
 SOURCES                += $$PWD/qextserialport.cpp \
-                          $$PWD/qextserialenumerator.cpp
+                          $$PWD/qextserialenumerator.cpp \
+                          $$PWD/qextserialcapture.cpp \
+                          $$PWD/qextserialmetrics.cpp \
+                          $$PWD/qextserialmerger.cpp \
+                          $$PWD/qextserialreplayer.cpp \
+                          $$PWD/qextserialtrace.cpp
 unix {
     SOURCES            += $$PWD/qextserialport_unix.cpp
     linux* {
@@ -27,6 +44,12 @@ win32:SOURCES          += $$PWD/qextserialport_win.cpp \
 linux*{
     !qesp_linux_udev:DEFINES += QESP_NO_UDEV
     qesp_linux_udev: LIBS += -ludev
+    qesp_sdt:DEFINES += QESP_HAVE_SDT
+}
+
+qesp_lz4 {
+    DEFINES += QESP_HAVE_LZ4
+    LIBS += -llz4
 }
 
 macx:LIBS              += -framework IOKit -framework CoreFoundation
@@ -44,7 +44,16 @@
 //
 
 #include "qextserialport.h"
+#include "qextserialenumerator.h"
+#include "qextserialtrace_p.h"
+#include "qextserialcapture_p.h"
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QtAlgorithms>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QSemaphore>
+#include <QtCore/QVector>
 #ifdef Q_OS_UNIX
 #  include <termios.h>
 #elif (defined Q_OS_WIN)
@@ -52,6 +61,13 @@
 #endif
 #include <stdlib.h>
 
+// Linux accepts arbitrary baud rates through the termios2 ioctls (BOTHER).
+// The layout of struct termios2 differs on a few architectures, skip those.
+#if defined(Q_OS_LINUX) && !defined(__sparc__) && !defined(__mips__) \
+    && !defined(__alpha__) && !defined(__powerpc__)
+#  define QESP_HAVE_TERMIOS2
+#endif
+
 // This is QextSerialPort's read buffer, needed by posix system.
 // ref: QRingBuffer & QIODevicePrivateLinearBuffer
 class QextReadBuffer
@@ -115,6 +131,14 @@ public:
         return writePtr;
     }
 
+    inline size_t bufferCapacity() const {
+        return capacity;
+    }
+
+    inline void setGrowth(size_t growth) {
+        basicBlockSize = growth;
+    }
+
     inline void chop(int size) {
         if (size >= len)
             clear();
@@ -169,9 +193,98 @@ private:
     size_t basicBlockSize;
 };
 
+// Per-port counters. Updated with relaxed atomics on the I/O paths so that
+// statistics() may be called from any thread; define QESP_NO_STATISTICS to
+// compile them out entirely.
+#ifndef QESP_NO_STATISTICS
+struct QextPortCounters
+{
+    QAtomicInteger<quint64> bytesReceived;
+    QAtomicInteger<quint64> bytesSent;
+    QAtomicInteger<quint64> readCalls;
+    QAtomicInteger<quint64> writeCalls;
+    QAtomicInteger<quint64> notifierWakeups;
+    QAtomicInteger<quint64> readyReadEmitted;
+    QAtomicInteger<quint64> wouldBlock;
+    QAtomicInteger<quint64> shortWrites;
+    QAtomicInteger<quint64> rxBufferHighWater;
+    QAtomicInteger<quint64> rxBufferReallocs;
+    QAtomicInteger<quint64> settingsApplied;
+};
+#  define QESP_COUNT(counter, n) counters.counter.fetchAndAddRelaxed(quint64(n))
+#else
+#  define QESP_COUNT(counter, n) do {} while (false)
+#endif
+
+// Log-bucketed latency histogram in nanoseconds, in the manner of HDR
+// histograms: every power of two is split into 8 linear sub-buckets, so a
+// recorded value is off by at most 12.5%. Recording is a single relaxed
+// fetch-and-add and may happen from any thread.
+class QextLatencyHistogram
+{
+public:
+    enum { SubBuckets = 8, SubBucketBits = 3, Buckets = 46 * SubBuckets };
+
+    static inline int bucketOf(qint64 nsecs) {
+        if (nsecs < SubBuckets)
+            return nsecs < 0 ? 0 : int(nsecs);
+        int exponent = 63 - int(qCountLeadingZeroBits(quint64(nsecs)));
+        int sub = int(nsecs >> (exponent - SubBucketBits)) & (SubBuckets - 1);
+        return qMin((exponent - SubBucketBits + 1) * SubBuckets + sub, int(Buckets) - 1);
+    }
+
+    // highest value that falls into \a bucket
+    static inline qint64 bucketValue(int bucket) {
+        if (bucket < SubBuckets)
+            return bucket;
+        int exponent = bucket / SubBuckets + SubBucketBits - 1;
+        qint64 lower = qint64(SubBuckets + bucket % SubBuckets) << (exponent - SubBucketBits);
+        return lower + (qint64(1) << (exponent - SubBucketBits)) - 1;
+    }
+
+    inline void record(qint64 nsecs) {
+        counts[bucketOf(nsecs)].fetchAndAddRelaxed(1);
+    }
+
+    quint64 samples() const;
+    qint64 percentile(double percentile) const;
+    void reset();
+
+private:
+    QAtomicInteger<quint64> counts[Buckets];
+};
+
+struct QextLatencyHistograms
+{
+    QextLatencyHistogram delivery;
+    QextLatencyHistogram readLockHold;
+    QextLatencyHistogram writeDwell;
+};
+
+// Wait and hold times at one profiled lock site, see QextProfiledLocker.
+struct QextLockSiteStats
+{
+    QAtomicInteger<quint64> acquisitions;
+    QAtomicInteger<quint64> contended;
+    QAtomicInteger<quint64> totalWait;
+    QAtomicInteger<quint64> maxWait;
+    QAtomicInteger<quint64> totalHold;
+    QAtomicInteger<quint64> maxHold;
+    QextLatencyHistogram wait;
+    QextLatencyHistogram hold;
+};
+
+struct QextLockProfiles
+{
+    enum { Sites = QextSerialPort::SettersLock + 1 };
+    QextLockSiteStats sites[Sites];
+};
+
 class QWinEventNotifier;
 class QReadWriteLock;
 class QSocketNotifier;
+class QTimer;
+class QextSerialEnumerator;
 
 class QextSerialPortPrivate
 {
@@ -187,6 +300,7 @@ public:
         DFE_DataBits = 0x0008,
         DFE_Flow = 0x0010,
         DFE_TimeOut = 0x0100,
+        DFE_RecordSize = 0x0200,
         DFE_ALL = 0x0fff,
         DFE_Settings_Mask = 0x00ff //without TimeOut
     };
@@ -195,15 +309,93 @@ public:
     PortSettings settings;
     QextReadBuffer readBuffer;
     int settingsDirtyFlags;
+    int settingsTransaction;
     ulong lastErr;
     QextSerialPort::QueryMode queryMode;
+    int recordSize;
+    bool openPending;
+    bool pendingOpenResult;
+    QIODevice::OpenMode pendingOpenMode;
+    QSemaphore openDone;
+
+    // busy-poll / adaptive polling state
+    int busyPollBudget;
+    bool adaptivePolling;
+    bool batchedPolling;
+    int pollStreak;
+    QElapsedTimer lastWakeup;
+
+    // adaptive read controller
+    enum { ChunkBuckets = 17 };
+    bool adaptiveReads;
+    int maxReadLatency;
+    QTimer *latencyTimer;
+    QElapsedTimer lastArrival;
+    quint32 chunkHistogram[ChunkBuckets];
+    ReadTuning tuning;
+
+#ifndef QESP_NO_STATISTICS
+    QextPortCounters counters;
+#endif
+
+    // latency histograms, null while disabled; the storage lives until the
+    // port is destroyed so a recorder racing with disabling stays valid
+    QAtomicPointer<QextLatencyHistograms> histograms;
+    QextLatencyHistograms *histogramStorage;
+    QElapsedTimer clock;
+    qint64 rxStamp;
+
+    // lock profiling, null while disabled; kept like histogramStorage
+    QAtomicPointer<QextLockProfiles> lockProfiles;
+    QextLockProfiles *lockProfileStorage;
+
+    // RX/TX capture, null while stopped; kept like histogramStorage
+    QAtomicPointer<QextCapture> capture;
+    QextCapture *captureStorage;
+
+    // receive timestamps, one per read from the driver into readBuffer;
+    // entries before rxStampHead are consumed
+    struct RxStamp
+    {
+        qint64 size;
+        qint64 timestamp;
+    };
+    bool rxTimestamps;
+    QVector<RxStamp> rxStamps;
+    int rxStampHead;
+    qint64 rxStampedBytes;
+
+    // this port's track in trace recordings, named once per recording
+    int traceTrack;
+    QAtomicInt traceGeneration;
+
+    // copy of port for QextSerialMetricsExporter, guarded by the port
+    // registry's mutex rather than lock
+    QString metricsName;
+
+    // auto-reconnect state
+    bool bound;
+    QextPortFilter boundIdentity;
+    QextSerialEnumerator *hotplug;
+    QTimer *reconnectTimer;
+    QIODevice::OpenMode reconnectMode;
+    QElapsedTimer downSince;
+    int reconnectAttempts;
+    int reconnectDelay;
+    int reconnectInitialDelay;
+    int reconnectMaxDelay;
 
     // platform specific members
 #ifdef Q_OS_UNIX
     int fd;
     QSocketNotifier *readNotifier;
+    QTimer *pollTimer;
     struct termios currentTermios;
+    struct termios appliedTermios;
     struct termios oldTermios;
+    int currentFileFlags;
+    int customBaudRate;
+    int appliedCustomBaudRate;
 #elif (defined Q_OS_WIN)
     HANDLE handle;
     OVERLAPPED overlap;
@@ -227,22 +419,57 @@ public:
     void platformSpecificDestruct();
     void platformSpecificInit();
     void translateError(ulong error);
-    void updatePortSettings();
+    void updatePortSettings(QextSerialPort::ApplyMode when = QextSerialPort::ApplyNow);
+    void updatePortSettings_sys(QextSerialPort::ApplyMode when);
 
     qint64 readData_sys(char *data, qint64 maxSize);
     qint64 writeData_sys(const char *data, qint64 maxSize);
     void setDtr_sys(bool set=true);
     void setRts_sys(bool set=true);
     bool open_sys(QIODevice::OpenMode mode);
+    bool openDevice_sys();
+    void finishOpen_sys(QIODevice::OpenMode mode);
     bool close_sys();
     bool flush_sys();
     ulong lineStatus_sys();
     qint64 bytesAvailable_sys() const;
+    int actualBaudRate_sys() const;
+    qint64 outputQueueDelay_sys() const;
+    void updatePollMode_sys(qint64 bytesRead);
+
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 fillReadBuffer(qint64 minSize = 0);
+    void updateReadTuning(qint64 bytesRead);
+    void resetReadTuning();
+    void emitReadyRead();
+    void stampArrival(qint64 bytesRead);
+    // readyRead() only announces whole records
+    bool canAnnounce() const { return readBuffer.size() >= qMax(recordSize, 1); }
+    qint64 traceStart() const { return QextTraceRecorder::isActive() ? QextTraceRecorder::now() : 0; }
+    void traceSlice(const char *name, qint64 start, qint64 value = -1);
+    void traceLockWait(qint64 start);
+    void traceCounter(const char *name, qint64 value);
+    void nameTraceTrack();
+    static void writeMetrics(QByteArray *out);
+    inline void captureData(QextCapture::Direction direction, const char *data, qint64 size) {
+        if (size > 0) {
+            if (QextCapture *c = capture.loadAcquire())
+                c->append(direction, data, size);
+        }
+    }
+    qint64 busyPoll();
+    QByteArray takeStamped(qint64 *timestamp);
+    void dropConsumedStamps();
+    void followDevice(const QextPortInfo &info);
 
 #ifdef Q_OS_WIN
     void _q_onWinEvent(HANDLE h);
 #endif
     void _q_canRead();
+    void _q_openFinished(bool success);
+    void _q_deviceDiscovered(const QextPortInfo &info);
+    void _q_deviceRemoved(const QextPortInfo &info);
+    void _q_reconnect();
 
     QextSerialPort *q_ptr;
 };
@@ -31,6 +31,7 @@
 
 #include "qextserialport.h"
 #include "qextserialport_p.h"
+#include "qextserialtrace_p.h"
 #include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
@@ -41,11 +42,19 @@
 #include <QtCore/QMutexLocker>
 #include <QtCore/QDebug>
 #include <QtCore/QSocketNotifier>
+#include <QtCore/QTimer>
+
+// adaptive polling thresholds
+static const qint64 HeavyTrafficGapNs = 1000000; // wakeups closer than this count as heavy traffic
+static const int HeavyTrafficWakeups = 8;        // consecutive heavy wakeups before batching
+static const int QuietPollTicks = 16;            // empty batched polls before notifier mode again
+static const int BatchedPollInterval = 1;        // msec
 
 void QextSerialPortPrivate::platformSpecificInit()
 {
     fd = 0;
     readNotifier = 0;
+    pollTimer = 0;
 }
 
 /*!
@@ -62,16 +71,21 @@ static QString fullPortName(const QString &name)
     return QLatin1String("/dev/")+name;
 }
 
-bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
+/*
+    Opens and configures the device. Touches nothing but the private data, so
+    it may run on a worker thread; finishOpen_sys() completes the job.
+*/
+bool QextSerialPortPrivate::openDevice_sys()
 {
-    Q_Q(QextSerialPort);
+    QESP_PROBE_TIMER(probeStart, open);
     //note: linux 2.6.21 seems to ignore O_NDELAY flag
     if ((fd = ::open(fullPortName(port).toLatin1() ,O_RDWR | O_NOCTTY | O_NDELAY)) != -1) {
-
-        /*In the Private class, We can not call QIODevice::open()*/
-        q->setOpenMode(mode);             // Flag the port as opened
         ::tcgetattr(fd, &oldTermios);    // Save the old termios
         currentTermios = oldTermios;   // Make a working copy
+        appliedTermios = oldTermios;
+        currentFileFlags = -1;
+        customBaudRate = 0;
+        appliedCustomBaudRate = 0;
         ::cfmakeraw(&currentTermios);   // Enable raw access
 
         /*set up other port settings*/
@@ -91,21 +105,41 @@ bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
         currentTermios.c_cc[VSUSP] = vdisable;
 #endif //_POSIX_VDISABLE
         settingsDirtyFlags = DFE_ALL;
-        updatePortSettings();
-
-        if (queryMode == QextSerialPort::EventDriven) {
-            readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, q);
-            q->connect(readNotifier, SIGNAL(activated(int)), q, SLOT(_q_canRead()));
-        }
+        updatePortSettings_sys(QextSerialPort::ApplyFlush);
+        QESP_PROBE3(open, port.toLocal8Bit().constData(), 1, QESP_PROBE_ELAPSED(probeStart));
         return true;
     } else {
         translateError(errno);
+        QESP_PROBE3(open, port.toLocal8Bit().constData(), 0, QESP_PROBE_ELAPSED(probeStart));
         return false;
     }
 }
 
+/*
+    Must run in the thread the port lives in.
+*/
+void QextSerialPortPrivate::finishOpen_sys(QIODevice::OpenMode mode)
+{
+    Q_Q(QextSerialPort);
+    /*In the Private class, We can not call QIODevice::open()*/
+    q->setOpenMode(mode);             // Flag the port as opened
+    if (queryMode == QextSerialPort::EventDriven) {
+        readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, q);
+        q->connect(readNotifier, SIGNAL(activated(int)), q, SLOT(_q_canRead()));
+    }
+}
+
+bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
+{
+    if (!openDevice_sys())
+        return false;
+    finishOpen_sys(mode);
+    return true;
+}
+
 bool QextSerialPortPrivate::close_sys()
 {
+    QESP_PROBE1(close, port.toLocal8Bit().constData());
     // Force a flush and then restore the original termios
     flush_sys();
     // Using both TCSAFLUSH and TCSANOW here discards any pending input
@@ -115,6 +149,12 @@ bool QextSerialPortPrivate::close_sys()
         delete readNotifier;
         readNotifier = 0;
     }
+    if (pollTimer) {
+        delete pollTimer;
+        pollTimer = 0;
+    }
+    batchedPolling = false;
+    pollStreak = 0;
     return true;
 }
 
@@ -132,6 +172,68 @@ qint64 QextSerialPortPrivate::bytesAvailable_sys() const
     return bytesQueued;
 }
 
+/*
+    Estimated time in nanoseconds until the bytes waiting in the driver's
+    output queue have been transmitted.
+*/
+qint64 QextSerialPortPrivate::outputQueueDelay_sys() const
+{
+    int queued = 0;
+    int baud = customBaudRate ? customBaudRate : int(settings.BaudRate);
+    if (baud <= 0 || ::ioctl(fd, TIOCOUTQ, &queued) == -1 || queued <= 0)
+        return 0;
+    int bitsPerChar = 1 + int(settings.DataBits) + (settings.Parity == PAR_NONE ? 0 : 1)
+            + (settings.StopBits == STOP_2 ? 2 : 1);
+    return qint64(queued) * bitsPerChar * 1000000000 / baud;
+}
+
+/*
+    NAPI-like switching between notifier and batched polling. A burst of closely
+    spaced wakeups disables the read notifier in favour of a 1 ms poll timer; a
+    run of empty polls (or \a bytesRead < 0) brings the notifier back.
+*/
+void QextSerialPortPrivate::updatePollMode_sys(qint64 bytesRead)
+{
+    if (!readNotifier)
+        return;
+
+    if (!batchedPolling) {
+        qint64 gap = lastWakeup.isValid() ? lastWakeup.nsecsElapsed() : HeavyTrafficGapNs;
+        lastWakeup.start();
+        if (bytesRead > 0 && gap < HeavyTrafficGapNs)
+            ++pollStreak;
+        else
+            pollStreak = 0;
+        if (pollStreak < HeavyTrafficWakeups)
+            return;
+
+        Q_Q(QextSerialPort);
+        if (!pollTimer) {
+            pollTimer = new QTimer(q);
+            pollTimer->setTimerType(Qt::PreciseTimer);
+            pollTimer->setInterval(BatchedPollInterval);
+            q->connect(pollTimer, &QTimer::timeout, q, [this]{_q_canRead();});
+        }
+        readNotifier->setEnabled(false);
+        pollTimer->start();
+        batchedPolling = true;
+        pollStreak = 0;
+    } else {
+        if (bytesRead == 0)
+            ++pollStreak;
+        else if (bytesRead > 0)
+            pollStreak = 0;
+        if (bytesRead >= 0 && pollStreak < QuietPollTicks)
+            return;
+
+        pollTimer->stop();
+        readNotifier->setEnabled(true);
+        batchedPolling = false;
+        pollStreak = 0;
+        lastWakeup.invalidate();
+    }
+}
+
 /*!
     Translates a system-specific error code to a QextSerialPort error code.  Used internally.
 */
@@ -205,8 +307,14 @@ unsigned long QextSerialPortPrivate::lineStatus_sys()
 qint64 QextSerialPortPrivate::readData_sys(char *data, qint64 maxSize)
 {
     int retVal = ::read(fd, data, maxSize);
-    if (retVal == -1)
+    QESP_COUNT(readCalls, 1);
+    if (retVal > 0) {
+        QESP_COUNT(bytesReceived, retVal);
+    } else if (retVal == -1) {
+        if (errno == EAGAIN)
+            QESP_COUNT(wouldBlock, 1);
         lastErr = E_READ_FAILED;
+    }
 
     return retVal;
 }
@@ -221,13 +329,96 @@ qint64 QextSerialPortPrivate::readData_sys(char *data, qint64 maxSize)
 */
 qint64 QextSerialPortPrivate::writeData_sys(const char *data, qint64 maxSize)
 {
+    QESP_PROBE_TIMER(probeStart, write);
     int retVal = ::write(fd, data, maxSize);
-    if (retVal == -1)
+    QESP_COUNT(writeCalls, 1);
+    if (retVal >= 0) {
+        QESP_COUNT(bytesSent, retVal);
+        if (retVal < maxSize)
+            QESP_COUNT(shortWrites, 1);
+    } else {
+        if (errno == EAGAIN)
+            QESP_COUNT(wouldBlock, 1);
         lastErr = E_WRITE_FAILED;
+    }
+    QESP_PROBE4(write, port.toLocal8Bit().constData(), maxSize, retVal, QESP_PROBE_ELAPSED(probeStart));
 
     return (qint64)retVal;
 }
 
+#ifdef QESP_HAVE_TERMIOS2
+// glibc's <termios.h> clashes with <asm/termbits.h>, so declare the kernel's
+// struct termios2 and its ioctls locally.
+struct qext_termios2
+{
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t c_line;
+    cc_t c_cc[19];
+    speed_t c_ispeed;
+    speed_t c_ospeed;
+};
+#  define QESP_TCGETS2  _IOR('T', 0x2A, struct qext_termios2)
+#  define QESP_TCSETS2  _IOW('T', 0x2B, struct qext_termios2)
+#  define QESP_TCSETSW2 _IOW('T', 0x2C, struct qext_termios2)
+#  define QESP_TCSETSF2 _IOW('T', 0x2D, struct qext_termios2)
+#  ifndef BOTHER
+#    define BOTHER 0010000
+#  endif
+#  ifndef CIBAUD
+#    define CIBAUD (CBAUD << 16)
+#  endif
+
+/*
+    Same as tcsetattr(), but with an arbitrary integer \a baudRate.
+*/
+static int setTermios2(int fd, const termios &config, int baudRate, QextSerialPort::ApplyMode when)
+{
+    qext_termios2 config2;
+    if (::ioctl(fd, QESP_TCGETS2, &config2) == -1)
+        return -1;
+    config2.c_iflag = config.c_iflag;
+    config2.c_oflag = config.c_oflag;
+    config2.c_cflag = (config.c_cflag & ~(CBAUD | CIBAUD)) | BOTHER;
+    config2.c_lflag = config.c_lflag;
+    config2.c_line = config.c_line;
+    memcpy(config2.c_cc, config.c_cc, qMin(sizeof(config2.c_cc), sizeof(config.c_cc)));
+    config2.c_ispeed = baudRate;
+    config2.c_ospeed = baudRate;
+
+    switch (when) {
+    case QextSerialPort::ApplyNow:
+        return ::ioctl(fd, QESP_TCSETS2, &config2);
+    case QextSerialPort::ApplyDrain:
+        return ::ioctl(fd, QESP_TCSETSW2, &config2);
+    default:
+        return ::ioctl(fd, QESP_TCSETSF2, &config2);
+    }
+}
+#endif
+
+int QextSerialPortPrivate::actualBaudRate_sys() const
+{
+#ifdef QESP_HAVE_TERMIOS2
+    qext_termios2 config2;
+    if (::ioctl(fd, QESP_TCGETS2, &config2) == -1)
+        return -1;
+    return int(config2.c_ospeed);
+#else
+    termios config;
+    if (::tcgetattr(fd, &config) == -1)
+        return -1;
+#  if defined(Q_OS_MAC) || defined(Q_OS_BSD4)
+    // speed_t holds the plain rate on BSD derived systems
+    return int(::cfgetospeed(&config));
+#  else
+    return int(settings.BaudRate);
+#  endif
+#endif
+}
+
 static void setBaudRate2Termios(termios *config, int baudRate)
 {
 #ifdef CBAUD
@@ -239,15 +430,37 @@ static void setBaudRate2Termios(termios *config, int baudRate)
 #endif
 }
 
+static bool termiosEqual(const termios &a, const termios &b)
+{
+    return a.c_iflag == b.c_iflag && a.c_oflag == b.c_oflag
+            && a.c_cflag == b.c_cflag && a.c_lflag == b.c_lflag
+            && ::cfgetispeed(&a) == ::cfgetispeed(&b)
+            && ::cfgetospeed(&a) == ::cfgetospeed(&b)
+            && memcmp(a.c_cc, b.c_cc, sizeof(a.c_cc)) == 0;
+}
+
+static int tcsetattrAction(QextSerialPort::ApplyMode when)
+{
+    switch (when) {
+    case QextSerialPort::ApplyNow:
+        return TCSANOW;
+    case QextSerialPort::ApplyDrain:
+        return TCSADRAIN;
+    default:
+        return TCSAFLUSH;
+    }
+}
+
 /*
     All the platform settings was performed in this function.
+    Everything that changed is collected in currentTermios and applied with one
+    tcsetattr(), which is skipped entirely when the result equals what the
+    device already has.
 */
-void QextSerialPortPrivate::updatePortSettings()
+void QextSerialPortPrivate::updatePortSettings_sys(QextSerialPort::ApplyMode when)
 {
-    if (!q_func()->isOpen() || !settingsDirtyFlags)
-        return;
-
     if (settingsDirtyFlags & DFE_BaudRate) {
+        customBaudRate = 0;
         switch (settings.BaudRate) {
         case BAUD50:
             setBaudRate2Termios(&currentTermios, B50);
@@ -350,6 +563,11 @@ void QextSerialPortPrivate::updatePortSettings()
         default:
             setBaudRate2Termios(&currentTermios, settings.BaudRate);
             break;
+#elif defined(QESP_HAVE_TERMIOS2)
+        default:
+            // not a Bxxx constant, applied through termios2 below
+            customBaudRate = settings.BaudRate;
+            break;
 #endif
         }
     }
@@ -436,22 +654,48 @@ void QextSerialPortPrivate::updatePortSettings()
         }
     }
 
-    /*if any thing in currentTermios changed, flush*/
-    if (settingsDirtyFlags & DFE_Settings_Mask)
-        ::tcsetattr(fd, TCSAFLUSH, &currentTermios);
-
+    if (settingsDirtyFlags & DFE_RecordSize) {
+        // let the driver collect a whole record before waking up a polling reader
+        int vmin = (queryMode == QextSerialPort::Polling) ? qMin(recordSize, 255) : 0;
+        currentTermios.c_cc[VMIN] = cc_t(vmin);
+    }
     if (settingsDirtyFlags & DFE_TimeOut) {
         int millisec = settings.Timeout_Millisec;
-        if (millisec == -1) {
-            ::fcntl(fd, F_SETFL, O_NDELAY);
-        } else {
-            //O_SYNC should enable blocking ::write()
-            //however this seems not working on Linux 2.6.21 (works on OpenBSD 4.2)
-            ::fcntl(fd, F_SETFL, O_SYNC);
+        //O_SYNC should enable blocking ::write()
+        //however this seems not working on Linux 2.6.21 (works on OpenBSD 4.2)
+        int fileFlags = (millisec == -1) ? O_NDELAY : O_SYNC;
+        if (fileFlags != currentFileFlags) {
+            ::fcntl(fd, F_SETFL, fileFlags);
+            currentFileFlags = fileFlags;
         }
-        ::tcgetattr(fd, &currentTermios);
-        currentTermios.c_cc[VTIME] = millisec/100;
-        ::tcsetattr(fd, TCSAFLUSH, &currentTermios);
+    }
+    if (settingsDirtyFlags & (DFE_RecordSize | DFE_TimeOut)) {
+        // with VMIN > 0 a VTIME of 0 would block until a whole record arrived;
+        // keep an inter-byte timeout of at least 100 ms so a partial record returns
+        int vtime = int(qMin(settings.Timeout_Millisec/100, 255L));
+        if (currentTermios.c_cc[VMIN] > 0)
+            vtime = qMax(vtime, 1);
+        currentTermios.c_cc[VTIME] = cc_t(vtime);
+    }
+
+    /*if any thing in currentTermios changed, apply it in one go*/
+    if (!termiosEqual(currentTermios, appliedTermios) || customBaudRate != appliedCustomBaudRate) {
+        QESP_COUNT(settingsApplied, 1);
+#ifdef QESP_HAVE_TERMIOS2
+        if (customBaudRate) {
+            if (setTermios2(fd, currentTermios, customBaudRate, when) == -1) {
+                translateError(errno);
+                QESP_WARNING()<<"QextSerialPort: failed to set baud rate"<<customBaudRate;
+            } else {
+                int actual = actualBaudRate_sys();
+                if (actual != customBaudRate)
+                    QESP_WARNING()<<"QextSerialPort: requested baud rate"<<customBaudRate<<"but the driver uses"<<actual;
+            }
+        } else
+#endif
+        ::tcsetattr(fd, tcsetattrAction(when), &currentTermios);
+        appliedTermios = currentTermios;
+        appliedCustomBaudRate = customBaudRate;
     }
 
     settingsDirtyFlags = 0;
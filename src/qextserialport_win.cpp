@@ -37,11 +37,7 @@
 #include <QtCore/QDebug>
 #include <QtCore/QRegExp>
 #include <QtCore/QMetaType>
-#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
-#  include <QtCore/QWinEventNotifier>
-#else
-#  include <QtCore/private/qwineventnotifier_p.h>
-#endif
+#include <QtCore/QWinEventNotifier>
 void QextSerialPortPrivate::platformSpecificInit()
 {
     handle = INVALID_HANDLE_VALUE;
@@ -72,9 +68,12 @@ static QString fullPortNameWin(const QString &name)
     return fullName;
 }
 
-bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
+/*
+    Opens and configures the device. Touches nothing but the private data, so
+    it may run on a worker thread; finishOpen_sys() completes the job.
+*/
+bool QextSerialPortPrivate::openDevice_sys()
 {
-    Q_Q(QextSerialPort);
     DWORD confSize = sizeof(COMMCONFIG);
     commConfig.dwSize = confSize;
     DWORD dwFlagsAndAttributes = 0;
@@ -85,7 +84,6 @@ bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
     handle = CreateFileW((wchar_t *)fullPortNameWin(port).utf16(), GENERIC_READ|GENERIC_WRITE,
                            0, NULL, OPEN_EXISTING, dwFlagsAndAttributes, NULL);
     if (handle != INVALID_HANDLE_VALUE) {
-        q->setOpenMode(mode);
         /*configure port settings*/
         GetCommConfig(handle, &commConfig, &confSize);
         GetCommState(handle, &(commConfig.dcb));
@@ -100,24 +98,45 @@ bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
         commConfig.dcb.fDtrControl = TRUE;
         /*flush all settings*/
         settingsDirtyFlags = DFE_ALL;
-        updatePortSettings();
+        updatePortSettings_sys(QextSerialPort::ApplyNow);
 
         //init event driven approach
         if (queryMode == QextSerialPort::EventDriven) {
             if (!SetCommMask(handle, EV_TXEMPTY | EV_RXCHAR | EV_DSR)) {
                 QESP_WARNING()<<"failed to set Comm Mask. Error code:"<<GetLastError();
+                CloseHandle(handle);
+                handle = INVALID_HANDLE_VALUE;
                 return false;
             }
-            winEventNotifier = new QWinEventNotifier(overlap.hEvent, q);
-            qRegisterMetaType<HANDLE>("HANDLE");
-            q->connect(winEventNotifier, SIGNAL(activated(HANDLE)), q, SLOT(_q_onWinEvent(HANDLE)), Qt::DirectConnection);
-            WaitCommEvent(handle, &eventMask, &overlap);
         }
         return true;
     }
     return false;
 }
 
+/*
+    Must run in the thread the port lives in.
+*/
+void QextSerialPortPrivate::finishOpen_sys(QIODevice::OpenMode mode)
+{
+    Q_Q(QextSerialPort);
+    q->setOpenMode(mode);
+    if (queryMode == QextSerialPort::EventDriven) {
+        winEventNotifier = new QWinEventNotifier(overlap.hEvent, q);
+        qRegisterMetaType<HANDLE>("HANDLE");
+        q->connect(winEventNotifier, SIGNAL(activated(HANDLE)), q, SLOT(_q_onWinEvent(HANDLE)), Qt::DirectConnection);
+        WaitCommEvent(handle, &eventMask, &overlap);
+    }
+}
+
+bool QextSerialPortPrivate::open_sys(QIODevice::OpenMode mode)
+{
+    if (!openDevice_sys())
+        return false;
+    finishOpen_sys(mode);
+    return true;
+}
+
 bool QextSerialPortPrivate::close_sys()
 {
     flush_sys();
@@ -154,6 +173,41 @@ qint64 QextSerialPortPrivate::bytesAvailable_sys() const
     return (qint64)-1;
 }
 
+/*
+    Estimated time in nanoseconds until the bytes waiting in the driver's
+    output queue have been transmitted.
+*/
+qint64 QextSerialPortPrivate::outputQueueDelay_sys() const
+{
+    DWORD Errors;
+    COMSTAT Status;
+    int baud = int(settings.BaudRate);
+    if (baud <= 0 || !ClearCommError(handle, &Errors, &Status) || !Status.cbOutQue)
+        return 0;
+    int bitsPerChar = 1 + int(settings.DataBits) + (settings.Parity == PAR_NONE ? 0 : 1)
+            + (settings.StopBits == STOP_1 ? 1 : 2);
+    return qint64(Status.cbOutQue) * bitsPerChar * 1000000000 / baud;
+}
+
+int QextSerialPortPrivate::actualBaudRate_sys() const
+{
+    DCB dcb;
+    ZeroMemory(&dcb, sizeof(DCB));
+    dcb.DCBlength = sizeof(DCB);
+    if (!GetCommState(handle, &dcb))
+        return -1;
+    return int(dcb.BaudRate);
+}
+
+/*
+    Adaptive polling is not implemented on Windows, notifications always come
+    from the comm event.
+*/
+void QextSerialPortPrivate::updatePollMode_sys(qint64 bytesRead)
+{
+    Q_UNUSED(bytesRead);
+}
+
 /*
     Translates a system-specific error code to a QextSerialPort error code.  Used internally.
 */
@@ -202,8 +256,11 @@ qint64 QextSerialPortPrivate::readData_sys(char *data, qint64 maxSize)
     } else if (!ReadFile(handle, (void *)data, (DWORD)maxSize, &bytesRead, NULL)) {
         failed = true;
     }
-    if (!failed)
+    QESP_COUNT(readCalls, 1);
+    if (!failed) {
+        QESP_COUNT(bytesReceived, bytesRead);
         return (qint64)bytesRead;
+    }
 
     lastErr = E_READ_FAILED;
     return -1;
@@ -245,8 +302,12 @@ qint64 QextSerialPortPrivate::writeData_sys(const char *data, qint64 maxSize)
         failed = true;
     }
 
-    if (!failed)
+    QESP_COUNT(writeCalls, 1);
+    if (!failed) {
+        // an overlapped write still in flight counts as sent
+        QESP_COUNT(bytesSent, bytesWritten ? qint64(bytesWritten) : maxSize);
         return (qint64)bytesWritten;
+    }
 
     lastErr = E_WRITE_FAILED;
     return -1;
@@ -320,11 +381,8 @@ void QextSerialPortPrivate::_q_onWinEvent(HANDLE h)
     WaitCommEvent(handle, &eventMask, &overlap);
 }
 
-void QextSerialPortPrivate::updatePortSettings()
+void QextSerialPortPrivate::updatePortSettings_sys(QextSerialPort::ApplyMode when)
 {
-    if (!q_ptr->isOpen() || !settingsDirtyFlags)
-        return;
-
     //fill struct : COMMCONFIG
     if (settingsDirtyFlags & DFE_BaudRate)
         commConfig.dcb.BaudRate = settings.BaudRate;
@@ -397,8 +455,14 @@ void QextSerialPortPrivate::updatePortSettings()
     }
 
 
-    if (settingsDirtyFlags & DFE_Settings_Mask)
+    if (settingsDirtyFlags & DFE_Settings_Mask) {
+        if (when != QextSerialPort::ApplyNow)
+            FlushFileBuffers(handle);
+        if (when == QextSerialPort::ApplyFlush)
+            PurgeComm(handle, PURGE_RXCLEAR);
         SetCommConfig(handle, &commConfig, sizeof(COMMCONFIG));
+        QESP_COUNT(settingsApplied, 1);
+    }
     if ((settingsDirtyFlags & DFE_TimeOut))
         SetCommTimeouts(handle, &commTimeouts);
     settingsDirtyFlags = 0;
@@ -0,0 +1,457 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#include "qextserialreplayer.h"
+#include "qextserialreplayer_p.h"
+#include "qextserialcapture_p.h"
+#include "qextserialtrace_p.h"
+#include "qextserialport_global.h"
+#include <QtCore/QThread>
+#ifdef Q_OS_UNIX
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <string.h>
+#  include <stdlib.h>
+#  include <termios.h>
+#  include <unistd.h>
+#endif
+
+class QextReplayThread : public QThread
+{
+public:
+    QextReplayThread(QextSerialReplayerPrivate *d) : d(d) {}
+
+protected:
+    void run() { d->run(); }
+
+private:
+    QextSerialReplayerPrivate *d;
+};
+
+QextSerialReplayerPrivate::QextSerialReplayerPrivate(QextSerialReplayer *q)
+    :masterFd(-1), timing(QextSerialReplayer::OriginalTiming), speed(1.0),
+      direction(QextSerialReplayer::Received), thread(0), q_ptr(q)
+{
+}
+
+QextSerialReplayerPrivate::~QextSerialReplayerPrivate()
+{
+    close_sys();
+}
+
+/*
+    Writes the records of one direction of the capture to the terminal,
+    each at the time of the first record plus its offset in the recording
+    divided by the speed.
+*/
+void QextSerialReplayerPrivate::run()
+{
+    QextCaptureReader reader;
+    if (!reader.open(fileName))
+        return;
+    const bool timed = timing != QextSerialReplayer::FastTiming;
+    const double scale = timing == QextSerialReplayer::ScaledTiming ? speed : 1.0;
+    const int wanted = direction == QextSerialReplayer::Received ? QextCapture::Rx : QextCapture::Tx;
+    qint64 origin = 0, start = 0, previous = 0, previousWrite = 0, deadline = 0;
+    bool first = true;
+    const char *payload;
+    int size;
+    qint64 timestamp;
+    while (!stopping.loadAcquire() && reader.nextBlock(&payload, &size, &timestamp)) {
+        const char *p = payload;
+        const char *end = payload + size;
+        while (p < end) {
+            quint64 delta, header;
+            if (!QextCaptureFormat::readVarint(&p, end, &delta) || !QextCaptureFormat::readVarint(&p, end, &header)
+                    || quint64(end - p) < (header >> 1))
+                break;
+            const char *data = p;
+            int length = int(header >> 1);
+            p += length;
+            timestamp += qint64(delta);
+            // blocks hold one direction each
+            if (int(header & 1) != wanted)
+                break;
+            if (first) {
+                origin = timestamp;
+                start = QextTraceRecorder::now();
+                deadline = start;
+            } else if (timed) {
+                deadline = start + qint64((timestamp - origin) / scale);
+                if (!sleepUntil(deadline))
+                    return;
+            }
+            if (!write_sys(data, length))
+                return;
+            qint64 written = QextTraceRecorder::now();
+            if (!first && timed) {
+                qint64 drift = qAbs((written - previousWrite) - qint64((timestamp - previous) / scale));
+                driftSum.fetchAndAddRelaxed(drift);
+                if (drift > maxDrift.load())
+                    maxDrift.store(drift);
+                lag.store(written - deadline);
+            }
+            first = false;
+            previous = timestamp;
+            previousWrite = written;
+            bytes.fetchAndAddRelaxed(quint64(length));
+            records.fetchAndAddRelaxed(1);
+            elapsed.store(written - start);
+        }
+        blocksSkipped.store(reader.blocksSkipped);
+    }
+}
+
+/*
+    Sleeps in short steps so stop() is not held up by a long pause in the
+    recording. Returns false if stopped.
+*/
+bool QextSerialReplayerPrivate::sleepUntil(qint64 deadline)
+{
+    for (;;) {
+        if (stopping.loadAcquire())
+            return false;
+        qint64 remaining = deadline - QextTraceRecorder::now();
+        if (remaining <= 0)
+            return true;
+        if (remaining < 1000)
+            QThread::yieldCurrentThread();
+        else
+            QThread::usleep(ulong(qMin(remaining, Q_INT64_C(50000000)) / 1000));
+    }
+}
+
+#ifdef Q_OS_UNIX
+bool QextSerialReplayerPrivate::openPseudoTerminal_sys()
+{
+    masterFd = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (masterFd == -1 || ::grantpt(masterFd) || ::unlockpt(masterFd) || !::ptsname(masterFd)) {
+        QESP_WARNING("QextSerialReplayer: cannot open a pseudo terminal");
+        close_sys();
+        return false;
+    }
+    slaveName = QString::fromLocal8Bit(::ptsname(masterFd));
+    // raw until the port opens the slave, so nothing is echoed back
+    struct termios attributes;
+    if (::tcgetattr(masterFd, &attributes) == 0) {
+        ::cfmakeraw(&attributes);
+        ::tcsetattr(masterFd, TCSANOW, &attributes);
+    }
+    ::fcntl(masterFd, F_SETFL, ::fcntl(masterFd, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+void QextSerialReplayerPrivate::close_sys()
+{
+    if (masterFd != -1)
+        ::close(masterFd);
+    masterFd = -1;
+    slaveName.clear();
+}
+
+/*
+    Writes all of \a data, waiting while the port does not read. What the
+    port sends is read and dropped so it never blocks on a full terminal.
+*/
+bool QextSerialReplayerPrivate::write_sys(const char *data, int size)
+{
+    char sink[4096];
+    while (size > 0) {
+        while (::read(masterFd, sink, sizeof(sink)) > 0) {
+        }
+        ssize_t n = ::write(masterFd, data, size_t(size));
+        if (n > 0) {
+            data += n;
+            size -= int(n);
+            continue;
+        }
+        if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            QESP_WARNING("QextSerialReplayer: write failed: %s", strerror(errno));
+            return false;
+        }
+        if (stopping.loadAcquire())
+            return false;
+        struct pollfd pfd;
+        pfd.fd = masterFd;
+        pfd.events = POLLIN | POLLOUT;
+        ::poll(&pfd, 1, 50);
+    }
+    return true;
+}
+#else
+bool QextSerialReplayerPrivate::openPseudoTerminal_sys()
+{
+    QESP_WARNING("QextSerialReplayer: pseudo terminals are not supported on this platform");
+    return false;
+}
+
+void QextSerialReplayerPrivate::close_sys()
+{
+}
+
+bool QextSerialReplayerPrivate::write_sys(const char *data, int size)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return false;
+}
+#endif // Q_OS_UNIX
+
+/*!
+    \class QextSerialReplayer
+
+    \brief The QextSerialReplayer class plays a capture back into a pseudo
+    terminal, so a QextSerialPort receives the recorded traffic again.
+
+    This reproduces problems seen in the field from a file written by
+    QextSerialPort::startCapture(), and feeds decoders realistic input for
+    benchmarks. openPseudoTerminal() creates the terminal; a port opened on
+    portName() then reads what the recorded port received (or, with
+    setDirection(), what it sent).
+
+    The records can be played with the original timing, with the timing
+    scaled by a speed factor, or as fast as the port reads them; see
+    setTiming(). Playback runs on its own thread. The file is read through a
+    memory mapped window of 64 MiB, so recordings of any size are replayed
+    without loading them. Blocks are decompressed if the library was built
+    with \c{CONFIG += qesp_lz4}; otherwise compressed blocks are skipped and
+    counted. A file from a rotating capture is replayed on its own; start the
+    next one when finished() is emitted.
+
+    \code
+    QextSerialReplayer *replayer = new QextSerialReplayer(this);
+    replayer->openPseudoTerminal();
+    QextSerialPort *port = new QextSerialPort(replayer->portName());
+    port->open(QIODevice::ReadOnly);
+    replayer->setTiming(QextSerialReplayer::ScaledTiming, 10.0);
+    replayer->start("field.qcap");
+    \endcode
+
+    Pseudo terminals are only available on Unix.
+*/
+
+/*!
+    \enum QextSerialReplayer::Timing
+
+    \value OriginalTiming   records are written at their recorded times
+    \value ScaledTiming     the pauses between records are divided by speed()
+    \value FastTiming       records are written as fast as the port reads them
+*/
+
+/*!
+    \enum QextSerialReplayer::Direction
+
+    \value Received   replays the data the recorded port received
+    \value Sent       replays the data the recorded port sent
+*/
+
+/*!
+    \fn void QextSerialReplayer::finished()
+
+    This signal is emitted when the replay reached the end of the file, was
+    stopped, or failed.
+*/
+
+/*!
+    Constructs a replayer with the given \a parent.
+*/
+QextSerialReplayer::QextSerialReplayer(QObject *parent)
+    :QObject(parent), d_ptr(new QextSerialReplayerPrivate(this))
+{
+}
+
+/*!
+    Stops the replay and closes the pseudo terminal.
+*/
+QextSerialReplayer::~QextSerialReplayer()
+{
+    stop();
+    delete d_ptr;
+}
+
+/*!
+    Creates the pseudo terminal the replay is written to. Returns false on
+    failure, and always on platforms without pseudo terminals.
+
+    \sa portName()
+*/
+bool QextSerialReplayer::openPseudoTerminal()
+{
+    Q_D(QextSerialReplayer);
+    if (d->masterFd != -1)
+        return true;
+    return d->openPseudoTerminal_sys();
+}
+
+/*!
+    Returns the device name of the pseudo terminal, to be passed to a
+    QextSerialPort, or an empty string before openPseudoTerminal().
+*/
+QString QextSerialReplayer::portName() const
+{
+    Q_D(const QextSerialReplayer);
+    return d->slaveName;
+}
+
+/*!
+    Sets how the records are paced. \a speed is only used with ScaledTiming:
+    2.0 plays twice as fast as recorded, 0.5 at half speed. Takes effect with
+    the next start().
+*/
+void QextSerialReplayer::setTiming(Timing timing, double speed)
+{
+    Q_D(QextSerialReplayer);
+    d->timing = timing;
+    d->speed = speed > 0 ? speed : 1.0;
+}
+
+/*!
+    Returns the timing set by setTiming(); OriginalTiming by default.
+*/
+QextSerialReplayer::Timing QextSerialReplayer::timing() const
+{
+    Q_D(const QextSerialReplayer);
+    return d->timing;
+}
+
+/*!
+    Returns the speed factor of ScaledTiming.
+*/
+double QextSerialReplayer::speed() const
+{
+    Q_D(const QextSerialReplayer);
+    return d->speed;
+}
+
+/*!
+    Sets which \a direction of the recorded traffic is replayed; Received by
+    default. Takes effect with the next start().
+*/
+void QextSerialReplayer::setDirection(Direction direction)
+{
+    Q_D(QextSerialReplayer);
+    d->direction = direction;
+}
+
+/*!
+    Returns the direction set by setDirection().
+*/
+QextSerialReplayer::Direction QextSerialReplayer::direction() const
+{
+    Q_D(const QextSerialReplayer);
+    return d->direction;
+}
+
+/*!
+    Starts replaying the capture \a fileName, stopping a replay in progress
+    first. Returns false if no pseudo terminal is open. A file that cannot
+    be read ends the replay right away, with a warning and finished().
+*/
+bool QextSerialReplayer::start(const QString &fileName)
+{
+    Q_D(QextSerialReplayer);
+    stop();
+    if (d->masterFd == -1) {
+        QESP_WARNING("QextSerialReplayer: no pseudo terminal, call openPseudoTerminal() first");
+        return false;
+    }
+    d->fileName = fileName;
+    d->stopping.store(0);
+    d->bytes.store(0);
+    d->records.store(0);
+    d->blocksSkipped.store(0);
+    d->elapsed.store(0);
+    d->driftSum.store(0);
+    d->maxDrift.store(0);
+    d->lag.store(0);
+    if (!d->thread) {
+        d->thread = new QextReplayThread(d);
+        d->thread->setParent(this);
+        connect(d->thread, &QThread::finished, this, &QextSerialReplayer::finished);
+    }
+    d->thread->start();
+    return true;
+}
+
+/*!
+    Stops the replay and waits for the replay thread. Data already written
+    stays in the terminal.
+*/
+void QextSerialReplayer::stop()
+{
+    Q_D(QextSerialReplayer);
+    if (!d->thread)
+        return;
+    d->stopping.storeRelease(1);
+    d->thread->wait();
+}
+
+/*!
+    Returns true while a replay is in progress.
+*/
+bool QextSerialReplayer::isRunning() const
+{
+    Q_D(const QextSerialReplayer);
+    return d->thread && d->thread->isRunning();
+}
+
+/*!
+    Returns the progress of the running or last replay. It can be read at
+    any time from any thread.
+
+    throughput is the bytes written per second since the first record.
+    meanDrift and maxDrift compare each pause between two records as
+    replayed with the pause in the recording divided by the speed: they show
+    how faithfully the timing was reproduced. lag is how late the last
+    record was written relative to its schedule; a growing lag means the
+    port or the machine cannot keep up with the requested speed. The three
+    are 0 with FastTiming.
+*/
+ReplayStatistics QextSerialReplayer::statistics() const
+{
+    Q_D(const QextSerialReplayer);
+    ReplayStatistics stats = ReplayStatistics();
+    stats.bytes = d->bytes.load();
+    stats.records = d->records.load();
+    stats.blocksSkipped = d->blocksSkipped.load();
+    stats.elapsed = d->elapsed.load();
+    if (stats.elapsed > 0)
+        stats.throughput = double(stats.bytes) * 1e9 / double(stats.elapsed);
+    if (stats.records > 1)
+        stats.meanDrift = d->driftSum.load() / qint64(stats.records - 1);
+    stats.maxDrift = d->maxDrift.load();
+    stats.lag = d->lag.load();
+    return stats;
+}
+
+#include "moc_qextserialreplayer.cpp"
@@ -0,0 +1,99 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#ifndef _QEXTSERIALREPLAYER_H_
+#define _QEXTSERIALREPLAYER_H_
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include "qextserialport_global.h"
+
+/**
+ * progress of a replay started with QextSerialReplayer::start()
+ */
+struct ReplayStatistics
+{
+    quint64 bytes;
+    quint64 records;
+    quint64 blocksSkipped;
+    qint64 elapsed;         // ns since the first record was written
+    double throughput;      // bytes per second
+    qint64 meanDrift;       // ns, see QextSerialReplayer::statistics()
+    qint64 maxDrift;
+    qint64 lag;
+};
+
+class QextSerialReplayerPrivate;
+class QEXTSERIALPORT_EXPORT QextSerialReplayer : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QextSerialReplayer)
+    Q_ENUMS(Timing Direction)
+public:
+    enum Timing
+    {
+        OriginalTiming,
+        ScaledTiming,
+        FastTiming
+    };
+    enum Direction
+    {
+        Received,
+        Sent
+    };
+
+    explicit QextSerialReplayer(QObject *parent=0);
+    ~QextSerialReplayer();
+
+    bool openPseudoTerminal();
+    QString portName() const;
+
+    void setTiming(Timing timing, double speed = 1.0);
+    Timing timing() const;
+    double speed() const;
+    void setDirection(Direction direction);
+    Direction direction() const;
+
+    bool start(const QString &fileName);
+    void stop();
+    bool isRunning() const;
+    ReplayStatistics statistics() const;
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    Q_DISABLE_COPY(QextSerialReplayer)
+    QextSerialReplayerPrivate *d_ptr;
+};
+
+#endif /*_QEXTSERIALREPLAYER_H_*/
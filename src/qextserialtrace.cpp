@@ -0,0 +1,353 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#include "qextserialtrace_p.h"
+#include "qextserialport_global.h"
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include <string.h>
+#ifdef Q_OS_WIN
+#  include <QtCore/qt_windows.h>
+#else
+#  include <time.h>
+#endif
+
+QAtomicInt QextTraceRecorder::active;
+QAtomicInt QextTraceRecorder::currentGeneration;
+QAtomicInt QextTraceRecorder::nextTrack(1);
+
+enum {
+    FlushInterval = 100,        // ms
+    // port tracks are written as threads of the application's process; keep
+    // their ids clear of real thread ids
+    TrackBase = 1 << 30
+};
+
+class QextTraceFlusher : public QThread
+{
+protected:
+    void run();
+};
+
+// Returns a thread's buffer to the pool when the thread ends.
+struct QextTraceLease
+{
+    explicit QextTraceLease(QextTraceBuffer *buffer) : buffer(buffer) {}
+    ~QextTraceLease() { buffer->inUse.storeRelease(0); }
+    QextTraceBuffer *buffer;
+};
+
+struct QextTraceState
+{
+    QextTraceState() : flusher(0), stopping(false), firstEvent(true) {}
+    ~QextTraceState() { shutdown(); }
+
+    QextTraceBuffer *claimBuffer();
+    void drain();
+    void shutdown();
+
+    QMutex mutex;                       // guards all but the buffers' contents
+    QWaitCondition wake;
+    QList<QextTraceBuffer *> buffers;   // never freed, reused by later threads
+    QThreadStorage<QextTraceLease *> leases;
+    QAtomicInteger<quint64> dropped;
+    QextTraceFlusher *flusher;
+    bool stopping;
+
+    // used by the flush thread only while recording
+    QFile file;
+    QByteArray pid;
+    QHash<int, QByteArray> trackLabels;
+    bool firstEvent;
+};
+
+Q_GLOBAL_STATIC(QextTraceState, traceState)
+
+static void appendMicros(QByteArray *out, qint64 nsecs)
+{
+    *out += QByteArray::number(nsecs / 1000);
+    char fraction[5] = { '.', char('0' + nsecs / 100 % 10), char('0' + nsecs / 10 % 10),
+                         char('0' + nsecs % 10), 0 };
+    *out += fraction;
+}
+
+static void appendJsonString(QByteArray *out, const QByteArray &text)
+{
+    *out += '"';
+    for (int i = 0; i < text.size(); ++i) {
+        char c = text.at(i);
+        if (c == '"' || c == '\\')
+            *out += '\\';
+        if (uchar(c) >= 0x20) {
+            *out += c;
+        } else {
+            // control characters may only appear escaped
+            *out += "\\u00";
+            *out += QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+        }
+    }
+    *out += '"';
+}
+
+static void appendEvent(QextTraceState *s, QByteArray *out, const QextTraceEvent &e)
+{
+    QByteArray tid = QByteArray::number(TrackBase + e.track);
+    if (s->firstEvent)
+        s->firstEvent = false;
+    else
+        *out += ",\n";
+    switch (e.kind) {
+    case QextTraceEvent::TrackName:
+        *out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + s->pid + ",\"tid\":" + tid
+                + ",\"args\":{\"name\":";
+        appendJsonString(out, QByteArray("QextSerialPort ") + e.name);
+        *out += "}}";
+        delete [] e.name;
+        return;
+    case QextTraceEvent::Counter:
+        // counters are per process, so qualify them with the port
+        *out += "{\"name\":";
+        appendJsonString(out, s->trackLabels.value(e.track) + ' ' + e.name);
+        *out += ",\"ph\":\"C\"";
+        break;
+    default:
+        *out += "{\"name\":\"";
+        *out += e.name;
+        *out += "\",\"ph\":\"X\",\"dur\":";
+        appendMicros(out, e.duration);
+        break;
+    }
+    *out += ",\"pid\":" + s->pid + ",\"tid\":" + tid + ",\"ts\":";
+    appendMicros(out, e.timestamp);
+    if (e.value >= 0)
+        *out += ",\"args\":{\"bytes\":" + QByteArray::number(e.value) + '}';
+    *out += '}';
+}
+
+QextTraceBuffer *QextTraceState::claimBuffer()
+{
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < buffers.size(); ++i) {
+        if (buffers.at(i)->inUse.testAndSetAcquire(0, 1))
+            return buffers.at(i);
+    }
+    buffers.append(new QextTraceBuffer);
+    return buffers.last();
+}
+
+/*
+    Moves everything the rings hold into the file. Called by the flush
+    thread, and by shutdown() once it has ended.
+*/
+void QextTraceState::drain()
+{
+    QList<QextTraceBuffer *> rings;
+    {
+        QMutexLocker locker(&mutex);
+        rings = buffers;
+    }
+    QVector<quint32> heads;
+    heads.reserve(rings.size());
+    // learn the track names first: a port's name may sit in another
+    // thread's ring than its counters
+    for (int i = 0; i < rings.size(); ++i) {
+        QextTraceBuffer *ring = rings.at(i);
+        heads.append(ring->head.loadAcquire());
+        for (quint32 tail = ring->tail.load(); tail != heads.at(i); ++tail) {
+            const QextTraceEvent &e = ring->events[tail & (QextTraceBuffer::Capacity - 1)];
+            if (e.kind == QextTraceEvent::TrackName)
+                trackLabels.insert(e.track, QByteArray(e.name));
+        }
+    }
+    QByteArray out;
+    for (int i = 0; i < rings.size(); ++i) {
+        QextTraceBuffer *ring = rings.at(i);
+        quint32 tail = ring->tail.load();
+        for (; tail != heads.at(i); ++tail)
+            appendEvent(this, &out, ring->events[tail & (QextTraceBuffer::Capacity - 1)]);
+        ring->tail.storeRelease(tail);
+    }
+    if (!out.isEmpty())
+        file.write(out);
+}
+
+void QextTraceState::shutdown()
+{
+    QMutexLocker locker(&mutex);
+    if (!flusher || stopping)
+        return;
+    stopping = true;
+    wake.wakeAll();
+    locker.unlock();
+    flusher->wait();
+    drain();
+    locker.relock();
+    delete flusher;
+    flusher = 0;
+    stopping = false;
+    file.write("\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":\""
+               + QByteArray::number(dropped.load()) + "\"}}\n");
+    file.close();
+}
+
+void QextTraceFlusher::run()
+{
+    QextTraceState *s = traceState();
+    QMutexLocker locker(&s->mutex);
+    while (!s->stopping) {
+        s->wake.wait(&s->mutex, FlushInterval);
+        locker.unlock();
+        s->drain();
+        locker.relock();
+    }
+}
+
+bool QextTraceRecorder::start(const QString &fileName)
+{
+    QextTraceState *s = traceState();
+    QMutexLocker locker(&s->mutex);
+    if (s->flusher)
+        return false;
+    s->file.setFileName(fileName);
+    if (!s->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QESP_WARNING("QextSerialPort: cannot write trace %s", qPrintable(fileName));
+        return false;
+    }
+    // drop whatever racing threads recorded after the previous stop()
+    for (int i = 0; i < s->buffers.size(); ++i) {
+        QextTraceBuffer *ring = s->buffers.at(i);
+        quint32 head = ring->head.loadAcquire();
+        for (quint32 tail = ring->tail.load(); tail != head; ++tail) {
+            const QextTraceEvent &e = ring->events[tail & (QextTraceBuffer::Capacity - 1)];
+            if (e.kind == QextTraceEvent::TrackName)
+                delete [] e.name;
+        }
+        ring->tail.storeRelease(head);
+    }
+    s->dropped.store(0);
+    s->trackLabels.clear();
+    s->firstEvent = true;
+    s->pid = QByteArray::number(QCoreApplication::applicationPid());
+    s->file.write("{\"traceEvents\":[\n");
+    s->flusher = new QextTraceFlusher;
+    s->flusher->start(QThread::LowPriority);
+    currentGeneration.fetchAndAddRelaxed(1);
+    active.storeRelease(1);
+    return true;
+}
+
+void QextTraceRecorder::stop()
+{
+    active.storeRelease(0);
+    traceState()->shutdown();
+}
+
+/*
+    Nanoseconds on the clock Chrome and Perfetto use for their own JSON
+    traces: CLOCK_MONOTONIC, or the performance counter on Windows.
+*/
+qint64 QextTraceRecorder::now()
+{
+#ifdef Q_OS_WIN
+    static qint64 frequency = 0;
+    LARGE_INTEGER counter;
+    if (!frequency) {
+        QueryPerformanceFrequency(&counter);
+        frequency = counter.QuadPart;
+    }
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart / frequency * 1000000000
+            + counter.QuadPart % frequency * 1000000000 / frequency;
+#else
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void QextTraceRecorder::record(const QextTraceEvent &event)
+{
+    if (traceState.isDestroyed())
+        return;
+    QextTraceState *s = traceState();
+    if (!s->leases.hasLocalData())
+        s->leases.setLocalData(new QextTraceLease(s->claimBuffer()));
+    if (!s->leases.localData()->buffer->push(event)) {
+        s->dropped.fetchAndAddRelaxed(1);
+        if (event.kind == QextTraceEvent::TrackName)
+            delete [] event.name;
+    }
+}
+
+void QextTraceRecorder::slice(int track, const char *name, qint64 start, qint64 value)
+{
+    QextTraceEvent event;
+    event.timestamp = start;
+    event.duration = now() - start;
+    event.value = value;
+    event.name = name;
+    event.track = track;
+    event.kind = QextTraceEvent::Slice;
+    record(event);
+}
+
+void QextTraceRecorder::counter(int track, const char *name, qint64 value)
+{
+    QextTraceEvent event;
+    event.timestamp = now();
+    event.duration = 0;
+    event.value = value;
+    event.name = name;
+    event.track = track;
+    event.kind = QextTraceEvent::Counter;
+    record(event);
+}
+
+void QextTraceRecorder::nameTrack(int track, const QString &label)
+{
+    QextTraceEvent event;
+    event.timestamp = now();
+    event.duration = 0;
+    event.value = -1;
+    event.name = qstrdup(label.toUtf8().constData());
+    event.track = track;
+    event.kind = QextTraceEvent::TrackName;
+    record(event);
+}
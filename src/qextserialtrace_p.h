@@ -0,0 +1,177 @@
+/****************************************************************************
+** Copyright (c) 2000-2003 Wayne Roth
+** Copyright (c) 2004-2007 Stefan Sander
+** Copyright (c) 2007 Michal Policht
+** Copyright (c) 2008 Brandon Fosdick
+** Copyright (c) 2009-2010 Liam Staskawicz
+** Copyright (c) 2011 Debao Zhang
+** All right reserved.
+** Web: http://code.google.com/p/qextserialport/
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+** OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+** WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+****************************************************************************/
+
+
+#ifndef _QEXTSERIALTRACE_P_H_
+#define _QEXTSERIALTRACE_P_H_
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QESP API.  It exists for the convenience
+// of other QESP classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QtGlobal>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QString>
+
+// Static (USDT) probes for perf, bpftrace and SystemTap, enabled with
+// CONFIG += qesp_sdt on Linux.  Every probe has a semaphore that the kernel
+// bumps while a tracer is attached, so an idle probe costs one predictable
+// branch on a global and its arguments are never evaluated.
+#ifdef QESP_HAVE_SDT
+#  define _SDT_HAS_SEMAPHORES 1
+#  include <sys/sdt.h>
+#  include <time.h>
+
+#  define QESP_PROBE_SEMAPHORE(name) qextserialport_##name##_semaphore
+#  define QESP_DECLARE_PROBE(name) \
+    extern "C" unsigned short QESP_PROBE_SEMAPHORE(name) __attribute__((visibility("hidden")))
+#  define QESP_DEFINE_PROBE(name) \
+    extern "C" { unsigned short QESP_PROBE_SEMAPHORE(name) \
+        __attribute__((visibility("hidden"))) __attribute__((section(".probes"))); }
+#  define QESP_PROBE_ENABLED(name) Q_UNLIKELY(QESP_PROBE_SEMAPHORE(name))
+
+#  define QESP_PROBE1(name, a1) \
+    do { if (QESP_PROBE_ENABLED(name)) DTRACE_PROBE1(qextserialport, name, a1); } while (false)
+#  define QESP_PROBE2(name, a1, a2) \
+    do { if (QESP_PROBE_ENABLED(name)) DTRACE_PROBE2(qextserialport, name, a1, a2); } while (false)
+#  define QESP_PROBE3(name, a1, a2, a3) \
+    do { if (QESP_PROBE_ENABLED(name)) DTRACE_PROBE3(qextserialport, name, a1, a2, a3); } while (false)
+#  define QESP_PROBE4(name, a1, a2, a3, a4) \
+    do { if (QESP_PROBE_ENABLED(name)) DTRACE_PROBE4(qextserialport, name, a1, a2, a3, a4); } while (false)
+
+// Durations are only measured while the probe is attached; a probe that
+// gets attached halfway through reports 0.
+#  define QESP_PROBE_TIMER(var, name) \
+    const qint64 var = QESP_PROBE_ENABLED(name) ? qextProbeNow() : 0
+#  define QESP_PROBE_ELAPSED(var) ((var) ? qextProbeNow() - (var) : qint64(0))
+
+static inline qint64 qextProbeNow()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+#else
+#  define QESP_DECLARE_PROBE(name) struct qextProbeUnused_##name
+#  define QESP_DEFINE_PROBE(name)
+#  define QESP_PROBE_ENABLED(name) false
+#  define QESP_PROBE1(name, a1) do {} while (false)
+#  define QESP_PROBE2(name, a1, a2) do {} while (false)
+#  define QESP_PROBE3(name, a1, a2, a3) do {} while (false)
+#  define QESP_PROBE4(name, a1, a2, a3, a4) do {} while (false)
+#  define QESP_PROBE_TIMER(var, name) do {} while (false)
+#endif
+
+// port: port name, ok: 1 on success, duration in nanoseconds
+QESP_DECLARE_PROBE(open);
+// port
+QESP_DECLARE_PROBE(close);
+// port, bytes pulled into the read buffer, duration
+QESP_DECLARE_PROBE(can_read);
+// port, bytes requested, bytes returned (-1 on error), duration
+QESP_DECLARE_PROBE(read_data);
+// port, bytes requested, bytes written (-1 on error), duration
+QESP_DECLARE_PROBE(write);
+// port, duration of applying the dirty settings
+QESP_DECLARE_PROBE(settings);
+// udev action ("add", "remove", "change"), device node
+QESP_DECLARE_PROBE(hotplug);
+
+// Trace Event Format recorder behind QextSerialPort::startTraceRecording().
+// Each thread appends to a ring of its own; a background thread drains the
+// rings into the JSON file, so the I/O paths never take a lock. Events that
+// find their ring full are dropped and counted.
+struct QextTraceEvent
+{
+    enum Kind { Slice, Counter, TrackName };
+    qint64 timestamp;   // ns, same clock as QextTraceRecorder::now()
+    qint64 duration;
+    qint64 value;       // -1: no argument
+    const char *name;   // a literal; for TrackName a qstrdup()ed label
+    int track;
+    int kind;
+};
+
+class QextTraceBuffer
+{
+public:
+    enum { Capacity = 4096 };   // a power of two
+
+    QextTraceBuffer() : head(0), tail(0), inUse(1) {}
+
+    // only called by the thread that owns the buffer
+    bool push(const QextTraceEvent &event)
+    {
+        quint32 h = head.load();
+        if (h - tail.loadAcquire() == quint32(Capacity))
+            return false;
+        events[h & (Capacity - 1)] = event;
+        head.storeRelease(h + 1);
+        return true;
+    }
+
+    QAtomicInteger<quint32> head;   // written by the owner
+    QAtomicInteger<quint32> tail;   // written by the flush thread
+    QAtomicInt inUse;
+    QextTraceEvent events[Capacity];
+};
+
+class QextTraceRecorder
+{
+public:
+    static bool start(const QString &fileName);
+    static void stop();
+    static bool isActive() { return active.load() != 0; }
+    static int generation() { return currentGeneration.load(); }
+    static int newTrack() { return nextTrack.fetchAndAddRelaxed(1); }
+    static qint64 now();
+
+    static void slice(int track, const char *name, qint64 start, qint64 value = -1);
+    static void counter(int track, const char *name, qint64 value);
+    static void nameTrack(int track, const QString &label);
+
+private:
+    static void record(const QextTraceEvent &event);
+
+    static QAtomicInt active;
+    static QAtomicInt currentGeneration;
+    static QAtomicInt nextTrack;
+};
+
+#endif // _QEXTSERIALTRACE_P_H_